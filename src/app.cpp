@@ -42,7 +42,9 @@ IMPLEMENT_APP(LogViewerApp)
 LogViewerApp::LogViewerApp():
 	_files(),
 	_data(_files),
-	_filteredData(_data)
+	_filteredData(_data),
+	_loader(_data),
+	_follower(_data)
 {
 }
 
@@ -66,6 +68,8 @@ bool LogViewerApp::OnInit()
 	wxArtProvider::Push(new wxMicrosoftResourceArtProvider);
 #endif
 
+	_loader.AddListener(this);
+
 	SetAppName("LogViewer");
 	SetAppDisplayName("LogViewer");
 
@@ -79,6 +83,12 @@ bool LogViewerApp::OnInit()
 BEGIN_EVENT_TABLE(LogViewerApp, wxApp)
 	EVT_MENU(wxID_OPEN, LogViewerApp::OnOpen)
 	EVT_MENU(ID_LV_FILE_MANAGE, LogViewerApp::OnManage)
+	EVT_MENU(ID_LV_FILE_CANCEL_LOAD, LogViewerApp::OnCancelLoad)
+	EVT_UPDATE_UI(ID_LV_FILE_CANCEL_LOAD, LogViewerApp::OnCancelLoadUpdate)
+	EVT_MENU(ID_LV_FILE_FOLLOW, LogViewerApp::OnFollow)
+	EVT_UPDATE_UI(ID_LV_FILE_FOLLOW, LogViewerApp::OnFollowUpdate)
+	EVT_MENU(ID_LV_FILE_COMPRESS, LogViewerApp::OnCompress)
+	EVT_UPDATE_UI(ID_LV_FILE_COMPRESS, LogViewerApp::OnCompressUpdate)
 	EVT_MENU(wxID_CLEAR, LogViewerApp::OnClear)
 	EVT_MENU(wxID_EXIT, LogViewerApp::OnExit)
 END_EVENT_TABLE()
@@ -108,6 +118,47 @@ void LogViewerApp::OnManage(wxCommandEvent& event)
 	FileManagement();
 }
 
+void LogViewerApp::OnCancelLoad(wxCommandEvent& event)
+{
+	_loader.Cancel();
+}
+
+void LogViewerApp::OnCancelLoadUpdate(wxUpdateUIEvent& event)
+{
+	event.Enable(_loader.IsRunning());
+}
+
+void LogViewerApp::OnFollow(wxCommandEvent& event)
+{
+	if(_follower.IsFollowing())
+		_follower.Stop();
+	else
+		_follower.Start();
+}
+
+void LogViewerApp::OnFollowUpdate(wxUpdateUIEvent& event)
+{
+	event.Check(_follower.IsFollowing());
+}
+
+void LogViewerApp::OnCompress(wxCommandEvent& event)
+{
+	GetLogData().SetTextCompression(!GetLogData().IsTextCompressed());
+}
+
+void LogViewerApp::OnCompressUpdate(wxUpdateUIEvent& event)
+{
+	event.Enable(TextArena::IsCompressionAvailable());
+	event.Check(GetLogData().IsTextCompressed());
+}
+
+void LogViewerApp::LoadProgress(LogLoader& loader)
+{
+	// Follow newly loaded files.
+	if(!loader.IsRunning())
+		_follower.Refresh();
+}
+
 void LogViewerApp::OnClear(wxCommandEvent& event)
 {
 	for(FileDescriptor& fd : GetFileData())
@@ -150,35 +201,56 @@ void LogViewerApp::FileManagement()
 
 void LogViewerApp::ApplyUpdates()
 {
-	// First: Remove logs from removed and reloaded files
+	// Keep what a running load already parsed, its files are resumed below.
+	_loader.Cancel();
+	_follower.Clear();
+
+	// First: Remove logs from removed and rewritten reloaded files.
+	// Reloaded files only appended to keep their logs and are parsed from where they were,
+	// so are partially loaded ones, from where the cancelled load stopped.
 	std::vector<uint16_t> filesToRemove;
-	for(const FileDescriptor& fd : GetFileData()) {
-		if(fd.status==FileDescriptor::FILE_REMOVED || fd.status==FileDescriptor::FILE_RELOAD)
+	for(FileDescriptor& fd : GetFileData()) {
+		if(fd.status==FileDescriptor::FILE_LOADED && fd.partial)
+			fd.status = FileDescriptor::FILE_RELOAD;
+		if(fd.status==FileDescriptor::FILE_RELOAD && fd.IsUnchanged()) {
+			fd.status = FileDescriptor::FILE_LOADED;
+			fd.partial = false;
+		}
+		else if(fd.status==FileDescriptor::FILE_RELOAD && !fd.IsPrefixUnchanged())
+			fd.offset = FileDescriptor::UNKNOWN_OFFSET;
+		if(fd.status==FileDescriptor::FILE_REMOVED || (fd.status==FileDescriptor::FILE_RELOAD && fd.offset==FileDescriptor::UNKNOWN_OFFSET))
 			filesToRemove.push_back(fd.id);
 	}
 
-	GetLogData().RemoveLogIf([&](const Entry& entry){
-			return std::find(filesToRemove.begin(), filesToRemove.end(), entry.file) != filesToRemove.end();
-		});
+	GetLogData().RemoveFileLogs(filesToRemove);
 
-	// Second: Effectively revome files
-	GetFileData().RemoveFileIf([&](FileDescriptor& entry){
+	// Second: Effectively revome files, remaining ones are renumbered
+	GetLogData().RenumberFiles(GetFileData().RemoveFileIf([&](FileDescriptor& entry){
 			return entry.status==FileDescriptor::FILE_REMOVED;
-	});
+	}));
 
-	// Third: Load logs from new and reloaded files
-	Parser parser(GetLogData(), GetFileData());
+	// Third: Load logs from new and reloaded files, in background
+	std::vector<FileDescriptor*> filesToLoad;
 	for(FileDescriptor& fd : GetFileData()) {
-		if(fd.status==FileDescriptor::FILE_NEW || fd.status==FileDescriptor::FILE_RELOAD) {
-			parser.Parse(fd);
+		if(fd.status==FileDescriptor::FILE_NEW) {
+			fd.offset = FileDescriptor::UNKNOWN_OFFSET;
+			filesToLoad.push_back(&fd);
+		}
+		else if(fd.status==FileDescriptor::FILE_RELOAD) {
+			filesToLoad.push_back(&fd);
 		}
 	}
+	if(!filesToLoad.empty())
+		_loader.Start(filesToLoad);
 
 	// Fourth: Mark all files as loaded
 	for(FileDescriptor& fd : GetFileData())
 		fd.status = FileDescriptor::FILE_LOADED;
 
-	// Finally: Update stats and notify update
+	if(filesToLoad.empty())
+		_follower.Refresh();
+
+	// Finally: Update stats and notify update, loaded logs will follow
 	GetLogData().Synchronize();
 
 }
@@ -186,9 +258,9 @@ void LogViewerApp::ApplyUpdates()
 void LogViewerApp::CancelUpdates()
 {
 	// First: Remove new files
-	GetFileData().RemoveFileIf([&](FileDescriptor& entry){
+	GetLogData().RenumberFiles(GetFileData().RemoveFileIf([&](FileDescriptor& entry){
 			return entry.status==FileDescriptor::FILE_NEW;
-	});
+	}));
 
 	// Second: Mark removed and reloaded files to loaded.
 	for(FileDescriptor& fd : GetFileData())
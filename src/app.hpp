@@ -22,6 +22,8 @@
 
 
 #include "data.hpp"
+#include "follower.hpp"
+#include "loader.hpp"
 #include "model.hpp"
 
 
@@ -31,6 +33,9 @@ enum {
 	ID_LOGVIEWER_CUSTOM = wxID_HIGHEST + 1,
 
 	ID_LV_FILE_MANAGE,
+	ID_LV_FILE_CANCEL_LOAD,
+	ID_LV_FILE_FOLLOW,
+	ID_LV_FILE_COMPRESS,
 
 	ID_LV_LOGS,
 
@@ -41,6 +46,7 @@ enum {
 	ID_LV_EXTRA_TEXT,
 	ID_LV_SET_BEGIN_DATE,
 	ID_LV_SET_END_DATE,
+	ID_LV_GOTO_DATE,
 
 	ID_LV_LOGGER_PANEL,
 	ID_LV_LOGGER_LISTBOX,
@@ -72,7 +78,7 @@ enum {
 
 class Frame;
 
-class LogViewerApp : public wxApp
+class LogViewerApp : public wxApp, protected LogLoader::Listener
 {
     DECLARE_EVENT_TABLE();
 protected:
@@ -81,6 +87,8 @@ protected:
 	FileData		_files;
 	LogData			_data;
 	FilteredLogData _filteredData;
+	LogLoader		_loader;
+	LogFollower		_follower;
 
 public:
 	LogViewerApp();
@@ -94,6 +102,12 @@ public:
 	const FilteredLogData& GetFilteredLogData() const { return _filteredData; }
 	FilteredLogData& GetFilteredLogData() { return _filteredData; }
 
+	const LogLoader& GetLoader() const { return _loader; }
+	LogLoader& GetLoader() { return _loader; }
+
+	const LogFollower& GetFollower() const { return _follower; }
+	LogFollower& GetFollower() { return _follower; }
+
 	void OpenFiles(const wxArrayString& files);
 
 	int OpenFileDialog(wxWindow* parent, wxArrayString& paths);
@@ -107,9 +121,17 @@ protected:
 
 	void CancelUpdates();
 
+	virtual void LoadProgress(LogLoader& loader) override;
+
 private:
 	void OnOpen(wxCommandEvent& event);
 	void OnManage(wxCommandEvent& event);
+	void OnCancelLoad(wxCommandEvent& event);
+	void OnCancelLoadUpdate(wxUpdateUIEvent& event);
+	void OnFollow(wxCommandEvent& event);
+	void OnFollowUpdate(wxUpdateUIEvent& event);
+	void OnCompress(wxCommandEvent& event);
+	void OnCompressUpdate(wxUpdateUIEvent& event);
 	void OnClear(wxCommandEvent& event);
 	void OnExit(wxCommandEvent& event);
 };
@@ -0,0 +1,572 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+* bitmap.cpp
+* Copyright (C) 2019 Emilien Kia <Emilien.Kia+dev@gmail.com>
+*
+* logviewer is free software: you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the
+* Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* logviewer is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+#include <iterator>
+
+#include "bitmap.hpp"
+
+static const size_t CHUNK_WORDS = Bitmap::BLOCK_WORDS;
+
+static inline unsigned CountBits(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	return (unsigned)__popcnt64(bits);
+#else
+	return __builtin_popcountll(bits);
+#endif
+}
+
+static inline void SetBit(std::vector<uint64_t>& bits, uint16_t low)
+{
+	bits[low >> 6] |= (uint64_t)1 << (low & 63);
+}
+
+
+//
+// Bitmap chunk
+//
+
+bool Bitmap::Chunk::Contains(uint16_t low)const
+{
+	if (IsDense())
+	{
+		return (bits[low >> 6] >> (low & 63)) & 1;
+	}
+	return std::binary_search(array.begin(), array.end(), low);
+}
+
+void Bitmap::Chunk::Optimize()
+{
+	if (IsDense())
+	{
+		cardinality = 0;
+		for (uint64_t word : bits)
+		{
+			cardinality += CountBits(word);
+		}
+		if (cardinality <= ARRAY_MAX)
+		{
+			array.clear();
+			array.reserve(cardinality);
+			for (size_t word = 0; word < bits.size(); ++word)
+			{
+				for (uint64_t value = bits[word]; value != 0; value &= value - 1)
+				{
+					array.push_back((uint16_t)(word * 64 + CountTrailingZeros(value)));
+				}
+			}
+			std::vector<uint64_t>().swap(bits);
+		}
+	}
+	else
+	{
+		cardinality = array.size();
+		if (cardinality > ARRAY_MAX)
+		{
+			ToBits(*this, bits);
+			std::vector<uint16_t>().swap(array);
+		}
+	}
+}
+
+
+//
+// Bitmap
+//
+
+void Bitmap::ToBits(const Chunk& chunk, std::vector<uint64_t>& bits)
+{
+	if (chunk.IsDense())
+	{
+		bits = chunk.bits;
+		return;
+	}
+	bits.assign(CHUNK_WORDS, 0);
+	for (uint16_t low : chunk.array)
+	{
+		SetBit(bits, low);
+	}
+}
+
+Bitmap Bitmap::Range(uint32_t first, uint32_t last)
+{
+	Bitmap range;
+	for (uint64_t begin = first; begin < last; )
+	{
+		uint64_t end = std::min<uint64_t>(last, ((begin >> 16) + 1) << 16);
+		range._chunks.emplace_back();
+		Chunk& chunk = range._chunks.back();
+		chunk.key = (uint32_t)(begin >> 16);
+		chunk.cardinality = (uint32_t)(end - begin);
+		if (chunk.cardinality <= ARRAY_MAX)
+		{
+			for (uint64_t row = begin; row < end; ++row)
+			{
+				chunk.array.push_back((uint16_t)row);
+			}
+		}
+		else
+		{
+			// Whole words at once
+			chunk.bits.assign(CHUNK_WORDS, 0);
+			for (uint64_t row = begin; row < end; )
+			{
+				uint64_t stop = std::min(end, (row | 63) + 1);
+				uint64_t mask = stop - row == 64 ? ~(uint64_t)0 : (((uint64_t)1 << (stop - row)) - 1) << (row & 63);
+				chunk.bits[(row & 0xFFFF) >> 6] |= mask;
+				row = stop;
+			}
+		}
+		begin = end;
+	}
+	return range;
+}
+
+Bitmap Bitmap::Union(const std::vector<const Bitmap*>& bitmaps)
+{
+	// Chunks of all bitmaps, grouped by key.
+	std::vector<const Chunk*> chunks;
+	for (const Bitmap* bitmap : bitmaps)
+	{
+		for (const Chunk& chunk : bitmap->_chunks)
+		{
+			chunks.push_back(&chunk);
+		}
+	}
+	std::stable_sort(chunks.begin(), chunks.end(), [](const Chunk* a, const Chunk* b)
+	{
+		return a->key < b->key;
+	});
+
+	Bitmap result;
+	for (size_t first = 0, last; first < chunks.size(); first = last)
+	{
+		size_t total = 0;
+		for (last = first; last < chunks.size() && chunks[last]->key == chunks[first]->key; ++last)
+		{
+			total += chunks[last]->cardinality;
+		}
+		result._chunks.emplace_back();
+		Chunk& chunk = result._chunks.back();
+		chunk.key = chunks[first]->key;
+		if (total <= ARRAY_MAX)
+		{
+			// All sparse
+			chunk.array.reserve(total);
+			for (size_t n = first; n < last; ++n)
+			{
+				chunk.array.insert(chunk.array.end(), chunks[n]->array.begin(), chunks[n]->array.end());
+			}
+			std::sort(chunk.array.begin(), chunk.array.end());
+			chunk.array.erase(std::unique(chunk.array.begin(), chunk.array.end()), chunk.array.end());
+		}
+		else
+		{
+			chunk.bits.assign(CHUNK_WORDS, 0);
+			for (size_t n = first; n < last; ++n)
+			{
+				if (chunks[n]->IsDense())
+				{
+					for (size_t word = 0; word < CHUNK_WORDS; ++word)
+					{
+						chunk.bits[word] |= chunks[n]->bits[word];
+					}
+				}
+				else
+				{
+					for (uint16_t low : chunks[n]->array)
+					{
+						SetBit(chunk.bits, low);
+					}
+				}
+			}
+		}
+		chunk.Optimize();
+	}
+	return result;
+}
+
+void Bitmap::Add(uint32_t row)
+{
+	const uint32_t key = row >> 16;
+	if (_chunks.empty() || _chunks.back().key != key)
+	{
+		_chunks.emplace_back();
+		_chunks.back().key = key;
+		_chunks.back().cardinality = 0;
+	}
+	Chunk& chunk = _chunks.back();
+	if (chunk.IsDense())
+	{
+		SetBit(chunk.bits, (uint16_t)row);
+		chunk.cardinality++;
+	}
+	else
+	{
+		chunk.array.push_back((uint16_t)row);
+		if (++chunk.cardinality > ARRAY_MAX)
+		{
+			chunk.Optimize();
+		}
+	}
+}
+
+void Bitmap::Truncate(uint32_t row)
+{
+	const uint32_t key = row >> 16;
+	while (!_chunks.empty() && _chunks.back().key > key)
+	{
+		_chunks.pop_back();
+	}
+	if (_chunks.empty() || _chunks.back().key < key)
+	{
+		return;
+	}
+
+	Chunk& chunk = _chunks.back();
+	const uint16_t low = (uint16_t)row;
+	if (chunk.IsDense())
+	{
+		chunk.bits[low >> 6] &= ((uint64_t)1 << (low & 63)) - 1;
+		std::fill(chunk.bits.begin() + (low >> 6) + 1, chunk.bits.end(), 0);
+	}
+	else
+	{
+		chunk.array.erase(std::lower_bound(chunk.array.begin(), chunk.array.end(), low), chunk.array.end());
+	}
+	chunk.Optimize();
+	if (chunk.cardinality == 0)
+	{
+		_chunks.pop_back();
+	}
+}
+
+void Bitmap::Erase(const std::vector<uint32_t>& rows)
+{
+	if (rows.empty())
+	{
+		return;
+	}
+
+	// Chunks before the first erased row stay as they are, the following ones are rebuilt.
+	auto it = std::lower_bound(_chunks.begin(), _chunks.end(), rows.front() >> 16, [](const Chunk& chunk, uint32_t key)
+	{
+		return chunk.key < key;
+	});
+	if (it == _chunks.end())
+	{
+		return;
+	}
+	Bitmap moved;
+	moved._chunks.assign(std::make_move_iterator(it), std::make_move_iterator(_chunks.end()));
+	_chunks.erase(it, _chunks.end());
+
+	auto erased = rows.begin();
+	moved.ForEach([&](uint32_t row)
+	{
+		erased = std::lower_bound(erased, rows.end(), row);
+		if (erased == rows.end() || *erased != row)
+		{
+			Add(row - (uint32_t)(erased - rows.begin()));
+		}
+	});
+}
+
+bool Bitmap::Contains(uint32_t row)const
+{
+	auto it = std::lower_bound(_chunks.begin(), _chunks.end(), row >> 16, [](const Chunk& chunk, uint32_t key)
+	{
+		return chunk.key < key;
+	});
+	return it != _chunks.end() && it->key == (row >> 16) && it->Contains((uint16_t)row);
+}
+
+size_t Bitmap::Cardinality()const
+{
+	size_t count = 0;
+	for (const Chunk& chunk : _chunks)
+	{
+		count += chunk.cardinality;
+	}
+	return count;
+}
+
+size_t Bitmap::GetMemorySize()const
+{
+	size_t size = _chunks.capacity() * sizeof(Chunk);
+	for (const Chunk& chunk : _chunks)
+	{
+		size += chunk.array.capacity() * sizeof(uint16_t) + chunk.bits.capacity() * sizeof(uint64_t);
+	}
+	return size;
+}
+
+const Bitmap::Chunk* Bitmap::FindChunk(uint32_t key, size_t& position)const
+{
+	auto it = std::lower_bound(_chunks.begin() + std::min(position, _chunks.size()), _chunks.end(), key, [](const Chunk& chunk, uint32_t key)
+	{
+		return chunk.key < key;
+	});
+	position = it - _chunks.begin();
+	return it != _chunks.end() && it->key == key ? &*it : nullptr;
+}
+
+void Bitmap::OrBlock(uint32_t block, uint64_t* bits, size_t& position)const
+{
+	const Chunk* chunk = FindChunk(block, position);
+	if (chunk == nullptr)
+	{
+		return;
+	}
+	if (chunk->IsDense())
+	{
+		for (size_t word = 0; word < CHUNK_WORDS; ++word)
+		{
+			bits[word] |= chunk->bits[word];
+		}
+	}
+	else
+	{
+		for (uint16_t low : chunk->array)
+		{
+			bits[low >> 6] |= (uint64_t)1 << (low & 63);
+		}
+	}
+}
+
+void Bitmap::AndBlock(uint32_t block, uint64_t* bits, size_t& position)const
+{
+	const Chunk* chunk = FindChunk(block, position);
+	if (chunk == nullptr)
+	{
+		std::fill(bits, bits + CHUNK_WORDS, 0);
+	}
+	else if (chunk->IsDense())
+	{
+		for (size_t word = 0; word < CHUNK_WORDS; ++word)
+		{
+			bits[word] &= chunk->bits[word];
+		}
+	}
+	else
+	{
+		// Only rows of the array may stay.
+		uint64_t kept[CHUNK_WORDS] = {};
+		for (uint16_t low : chunk->array)
+		{
+			kept[low >> 6] |= bits[low >> 6] & ((uint64_t)1 << (low & 63));
+		}
+		std::copy(kept, kept + CHUNK_WORDS, bits);
+	}
+}
+
+void Bitmap::FillBlock(uint32_t block, uint64_t* bits, uint64_t first, uint64_t last)
+{
+	const uint64_t base = (uint64_t)block << 16;
+	first = std::min(std::max(first, base), base + CHUNK_SIZE) - base;
+	last = std::min(std::max(last, base), base + CHUNK_SIZE) - base;
+	for (size_t word = 0; word < CHUNK_WORDS; ++word)
+	{
+		const uint64_t begin = word * 64, end = begin + 64;
+		if (first <= begin && end <= last)
+		{
+			bits[word] = ~(uint64_t)0;
+		}
+		else if (end <= first || last <= begin)
+		{
+			bits[word] = 0;
+		}
+		else
+		{
+			uint64_t from = std::max(first, begin) - begin, to = std::min(last, end) - begin;
+			bits[word] = (to - from == 64 ? ~(uint64_t)0 : (((uint64_t)1 << (to - from)) - 1)) << from;
+		}
+	}
+}
+
+size_t Bitmap::CountBlock(const uint64_t* bits)
+{
+	size_t count = 0;
+	for (size_t word = 0; word < CHUNK_WORDS; ++word)
+	{
+		count += CountBits(bits[word]);
+	}
+	return count;
+}
+
+Bitmap& Bitmap::operator|=(const Bitmap& other)
+{
+	std::vector<Chunk> chunks;
+	chunks.reserve(_chunks.size() + other._chunks.size());
+	auto it = _chunks.begin();
+	for (const Chunk& chunk : other._chunks)
+	{
+		for (; it != _chunks.end() && it->key < chunk.key; ++it)
+		{
+			chunks.push_back(std::move(*it));
+		}
+		if (it == _chunks.end() || it->key != chunk.key)
+		{
+			chunks.push_back(chunk);
+			continue;
+		}
+		if (!it->IsDense() && !chunk.IsDense() && it->cardinality + chunk.cardinality <= ARRAY_MAX)
+		{
+			std::vector<uint16_t> array;
+			array.reserve(it->cardinality + chunk.cardinality);
+			std::set_union(it->array.begin(), it->array.end(), chunk.array.begin(), chunk.array.end(), std::back_inserter(array));
+			it->array.swap(array);
+		}
+		else
+		{
+			if (!it->IsDense())
+			{
+				ToBits(*it, it->bits);
+				std::vector<uint16_t>().swap(it->array);
+			}
+			if (chunk.IsDense())
+			{
+				for (size_t word = 0; word < CHUNK_WORDS; ++word)
+				{
+					it->bits[word] |= chunk.bits[word];
+				}
+			}
+			else
+			{
+				for (uint16_t low : chunk.array)
+				{
+					SetBit(it->bits, low);
+				}
+			}
+		}
+		it->Optimize();
+		chunks.push_back(std::move(*it++));
+	}
+	std::move(it, _chunks.end(), std::back_inserter(chunks));
+	_chunks.swap(chunks);
+	return *this;
+}
+
+Bitmap& Bitmap::operator&=(const Bitmap& other)
+{
+	size_t kept = 0;
+	auto it = other._chunks.begin();
+	for (Chunk& chunk : _chunks)
+	{
+		while (it != other._chunks.end() && it->key < chunk.key)
+		{
+			++it;
+		}
+		if (it == other._chunks.end() || it->key != chunk.key)
+		{
+			continue;
+		}
+		if (chunk.IsDense() && it->IsDense())
+		{
+			for (size_t word = 0; word < CHUNK_WORDS; ++word)
+			{
+				chunk.bits[word] &= it->bits[word];
+			}
+		}
+		else if (chunk.IsDense())
+		{
+			// Sparse result
+			std::vector<uint16_t> array;
+			std::copy_if(it->array.begin(), it->array.end(), std::back_inserter(array), [&chunk](uint16_t low)
+			{
+				return chunk.Contains(low);
+			});
+			std::vector<uint64_t>().swap(chunk.bits);
+			chunk.array.swap(array);
+		}
+		else
+		{
+			const Chunk& filter = *it;
+			chunk.array.erase(std::remove_if(chunk.array.begin(), chunk.array.end(), [&filter](uint16_t low)
+			{
+				return !filter.Contains(low);
+			}), chunk.array.end());
+		}
+		chunk.Optimize();
+		if (chunk.cardinality > 0)
+		{
+			if (&_chunks[kept] != &chunk)
+			{
+				_chunks[kept] = std::move(chunk);
+			}
+			++kept;
+		}
+	}
+	_chunks.resize(kept);
+	return *this;
+}
+
+Bitmap& Bitmap::operator-=(const Bitmap& other)
+{
+	size_t kept = 0;
+	auto it = other._chunks.begin();
+	for (Chunk& chunk : _chunks)
+	{
+		while (it != other._chunks.end() && it->key < chunk.key)
+		{
+			++it;
+		}
+		if (it != other._chunks.end() && it->key == chunk.key)
+		{
+			if (chunk.IsDense() && it->IsDense())
+			{
+				for (size_t word = 0; word < CHUNK_WORDS; ++word)
+				{
+					chunk.bits[word] &= ~it->bits[word];
+				}
+			}
+			else if (chunk.IsDense())
+			{
+				for (uint16_t low : it->array)
+				{
+					chunk.bits[low >> 6] &= ~((uint64_t)1 << (low & 63));
+				}
+			}
+			else
+			{
+				const Chunk& filter = *it;
+				chunk.array.erase(std::remove_if(chunk.array.begin(), chunk.array.end(), [&filter](uint16_t low)
+				{
+					return filter.Contains(low);
+				}), chunk.array.end());
+			}
+			chunk.Optimize();
+		}
+		if (chunk.cardinality > 0)
+		{
+			if (&_chunks[kept] != &chunk)
+			{
+				_chunks[kept] = std::move(chunk);
+			}
+			++kept;
+		}
+	}
+	_chunks.resize(kept);
+	return *this;
+}
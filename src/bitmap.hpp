@@ -0,0 +1,160 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+* bitmap.hpp
+* Copyright (C) 2019 Emilien Kia <Emilien.Kia+dev@gmail.com>
+*
+* logviewer is free software: you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the
+* Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* logviewer is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _BITMAP_HPP_
+#define _BITMAP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+/**
+ * Compressed set of rows.
+ * Rows are grouped by chunks of 65536, each chunk being stored as a sorted
+ * array of its low bits when sparse, or as a plain bitset when dense.
+ */
+class Bitmap
+{
+public:
+	/** Count of rows of a chunk. */
+	static const uint32_t CHUNK_SIZE = 1 << 16;
+	/** Count of rows above which a chunk is stored as a bitset. */
+	static const uint32_t ARRAY_MAX = 4096;
+
+	/** Rows in [first, last). */
+	static Bitmap Range(uint32_t first, uint32_t last);
+	/** Union of bitmaps, proportional to their sizes. */
+	static Bitmap Union(const std::vector<const Bitmap*>& bitmaps);
+
+	/** Add a row, greater than all the ones already present. */
+	void Add(uint32_t row);
+	/** Remove all rows from a given one. */
+	void Truncate(uint32_t row);
+	/** Remove sorted rows, following ones being moved down to fill the gaps. */
+	void Erase(const std::vector<uint32_t>& rows);
+	void Clear() { _chunks.clear(); }
+
+	bool Contains(uint32_t row)const;
+	bool IsEmpty()const { return _chunks.empty(); }
+	size_t Cardinality()const;
+	/** Memory used by the bitmap, in bytes. */
+	size_t GetMemorySize()const;
+
+	Bitmap& operator|=(const Bitmap& other);
+	Bitmap& operator&=(const Bitmap& other);
+	Bitmap& operator-=(const Bitmap& other);
+
+	/** Call function(row) for each row, in increasing order. */
+	template<typename Function>
+	void ForEach(Function function)const;
+
+	// @name Blocks of CHUNK_SIZE rows, as bitsets of BLOCK_WORDS words
+	// @{
+	static const size_t BLOCK_WORDS = CHUNK_SIZE / 64;
+	/** Or the rows of a block into a bitset.
+	 * Chunks are looked for from position, updated to look for following blocks. */
+	void OrBlock(uint32_t block, uint64_t* bits, size_t& position)const;
+	/** And the rows of a block into a bitset. */
+	void AndBlock(uint32_t block, uint64_t* bits, size_t& position)const;
+	/** Set the rows of a block in [first, last), clear the other ones. */
+	static void FillBlock(uint32_t block, uint64_t* bits, uint64_t first, uint64_t last);
+	static size_t CountBlock(const uint64_t* bits);
+	/** Call function(row) for each row of a block, in increasing order. */
+	template<typename Function>
+	static void ForEachInBlock(uint32_t block, const uint64_t* bits, Function function);
+	// @}
+
+protected:
+	struct Chunk
+	{
+		uint32_t key;
+		uint32_t cardinality;
+		/** Low bits of rows, when sparse. */
+		std::vector<uint16_t> array;
+		/** CHUNK_SIZE bits, when dense. */
+		std::vector<uint64_t> bits;
+
+		bool IsDense()const { return !bits.empty(); }
+		bool Contains(uint16_t low)const;
+		/** Convert to the representation fitting its cardinality. */
+		void Optimize();
+	};
+
+	static void ToBits(const Chunk& chunk, std::vector<uint64_t>& bits);
+	const Chunk* FindChunk(uint32_t key, size_t& position)const;
+
+	static inline unsigned CountTrailingZeros(uint64_t bits)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return index;
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+
+	std::vector<Chunk> _chunks;
+};
+
+template<typename Function>
+void Bitmap::ForEach(Function function)const
+{
+	for (const Chunk& chunk : _chunks)
+	{
+		const uint32_t base = chunk.key << 16;
+		if (chunk.IsDense())
+		{
+			for (size_t word = 0; word < chunk.bits.size(); ++word)
+			{
+				for (uint64_t bits = chunk.bits[word]; bits != 0; bits &= bits - 1)
+				{
+					function(base + (uint32_t)(word * 64 + CountTrailingZeros(bits)));
+				}
+			}
+		}
+		else
+		{
+			for (uint16_t low : chunk.array)
+			{
+				function(base + low);
+			}
+		}
+	}
+}
+
+template<typename Function>
+void Bitmap::ForEachInBlock(uint32_t block, const uint64_t* bits, Function function)
+{
+	const uint32_t base = block << 16;
+	for (size_t word = 0; word < BLOCK_WORDS; ++word)
+	{
+		for (uint64_t value = bits[word]; value != 0; value &= value - 1)
+		{
+			function(base + (uint32_t)(word * 64 + CountTrailingZeros(value)));
+		}
+	}
+}
+
+#endif // _BITMAP_HPP_
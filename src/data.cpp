@@ -26,11 +26,58 @@
 #include <wx/strconv.h>
 #include <wx/convauto.h>
 #include <wx/regex.h>
+#include <wx/filename.h>
 
 #include "data.hpp"
+#include "reader.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif // HAVE_ZSTD
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+
+//
+// StrView
+//
+
+bool StrView::IsAscii()const
+{
+	for (const char* p = begin; p < end; ++p)
+	{
+		if ((unsigned char)*p >= 0x80)
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
+wxString StrView::ToString()const
+{
+	if (empty())
+	{
+		return wxString();
+	}
+	wxString str = wxString::FromUTF8(begin, size());
+	if (str.IsEmpty())
+	{
+		str = wxString(begin, wxConvISO8859_1, size());
+	}
+	return str;
+}
 
 //
 // Formatter
@@ -50,6 +97,296 @@ wxString Formatter::FormatDate(const wxDateTime& date)
 		: "";
 }
 
+//
+// Log shard
+//
+
+void LogShard::AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, StrView thread, StrView logger, StrView source, StrView message)
+{
+	entries.push_back({
+		date,
+		file,
+		criticality,
+		threads.Get(thread),
+		loggers.Get(logger),
+		sources.Get(source),
+		texts.Add(message),
+		0
+		});
+}
+
+//
+// Text arena
+//
+
+// Texts are prefixed by their length.
+static const size_t TEXT_HEADER_SIZE = sizeof(uint32_t);
+
+// Pages are big enough for zstd to find repetitions without a dictionary.
+static const int COMPRESSION_LEVEL = 3;
+
+static StrView TextAt(const char* page, size_t offset)
+{
+	const char* text = page + offset;
+	uint32_t length;
+	memcpy(&length, text, TEXT_HEADER_SIZE);
+	return StrView(text + TEXT_HEADER_SIZE, text + TEXT_HEADER_SIZE + length);
+}
+
+// Recently unpacked pages, shared by all arenas, the most recent first.
+static const size_t UNPACKED_PAGE_COUNT = 16;
+static std::mutex s_unpackedMutex;
+static std::list<std::pair<uint64_t, std::shared_ptr<const std::vector<char>>>> s_unpacked;
+static std::atomic<uint64_t> s_pageIds{ 0 };
+
+TextRef TextArena::Add(const char* text, size_t size)
+{
+	if (size == 0)
+	{
+		return 0;
+	}
+	size_t required = TEXT_HEADER_SIZE + size;
+	size_t page = _current;
+	if (required > PAGE_SIZE / 4)
+	{
+		// Big texts have their own page.
+		page = _pages.size();
+		_pages.emplace_back();
+		_pages.back().text.reserve(required);
+	}
+	else if (_pages.empty() || _pages[page].IsPacked() || _pages[page].text.capacity() - _pages[page].text.size() < required)
+	{
+		page = _current = _pages.size();
+		_pages.emplace_back();
+		_pages.back().text.reserve(PAGE_SIZE);
+	}
+
+	std::vector<char>& buffer = _pages[page].text;
+	size_t offset = buffer.size();
+	uint32_t length = (uint32_t)size;
+	buffer.insert(buffer.end(), (const char*)&length, (const char*)&length + TEXT_HEADER_SIZE);
+	buffer.insert(buffer.end(), text, text + size);
+	return ((TextRef)(page + 1) << 32) | offset;
+}
+
+TextRef TextArena::Add(const wxString& text)
+{
+	wxScopedCharBuffer utf8 = text.utf8_str();
+	return Add(utf8.data(), utf8.length());
+}
+
+TextRef TextArena::Append(TextRef ref, StrView text)
+{
+	if (ref == 0)
+	{
+		return Add(text);
+	}
+	if (text.empty())
+	{
+		return ref;
+	}
+
+	std::vector<char>& buffer = _pages[(ref >> 32) - 1].text;
+	size_t offset = ref & 0xFFFFFFFF;
+	if (!_pages[(ref >> 32) - 1].IsPacked())
+	{
+		uint32_t length;
+		memcpy(&length, buffer.data() + offset, TEXT_HEADER_SIZE);
+		if (offset + TEXT_HEADER_SIZE + length == buffer.size() && buffer.capacity() - buffer.size() >= text.size())
+		{
+			// Last text of its page, extended in place.
+			buffer.insert(buffer.end(), text.begin, text.end);
+			length += text.size();
+			memcpy(buffer.data() + offset, &length, TEXT_HEADER_SIZE);
+			return ref;
+		}
+	}
+
+	std::string unpacked;
+	StrView previous = Get(ref, unpacked);
+	std::string str(previous.begin, previous.size());
+	str.append(text.begin, text.size());
+	return Add(str.data(), str.size());
+}
+
+StrView TextArena::Get(TextRef ref, std::string& buffer)const
+{
+	if (ref == 0)
+	{
+		return StrView();
+	}
+	const Page& page = _pages[(ref >> 32) - 1];
+	size_t offset = ref & 0xFFFFFFFF;
+	if (!page.IsPacked())
+	{
+		return TextAt(page.text.data(), offset);
+	}
+
+	std::shared_ptr<const std::vector<char>> unpacked;
+	{
+		std::lock_guard<std::mutex> lock(s_unpackedMutex);
+		for (auto it = s_unpacked.begin(); it != s_unpacked.end(); ++it)
+		{
+			if (it->first == page.id)
+			{
+				s_unpacked.splice(s_unpacked.begin(), s_unpacked, it);
+				unpacked = it->second;
+				break;
+			}
+		}
+	}
+	if (!unpacked)
+	{
+		// Unpacked out of the lock, others may still read cached pages meanwhile.
+		std::shared_ptr<std::vector<char>> text = std::make_shared<std::vector<char>>(page.size);
+		size_t size = 0;
+#ifdef HAVE_ZSTD
+		size = ::ZSTD_decompress(text->data(), text->size(), page.packed.data(), page.packed.size());
+		if (::ZSTD_isError(size))
+		{
+			size = 0;
+		}
+#endif // HAVE_ZSTD
+		if (size != page.size)
+		{
+			// Never serve a partially unpacked page as text.
+			wxLogError("Corrupted compressed text");
+			return StrView();
+		}
+		unpacked = text;
+
+		std::lock_guard<std::mutex> lock(s_unpackedMutex);
+		s_unpacked.emplace_front(page.id, unpacked);
+		if (s_unpacked.size() > UNPACKED_PAGE_COUNT)
+		{
+			s_unpacked.pop_back();
+		}
+	}
+
+	StrView text = TextAt(unpacked->data(), offset);
+	buffer.assign(text.begin, text.size());
+	return StrView(buffer.data(), buffer.data() + buffer.size());
+}
+
+TextRef TextArena::Adopt(TextArena&& other)
+{
+	TextRef base = (TextRef)_pages.size() << 32;
+	if (other._pages.empty())
+	{
+		return base;
+	}
+	// Do not keep the unused space of small arenas, as those of followed files.
+	other._pages[other._current].text.shrink_to_fit();
+	if (_pages.empty())
+	{
+		_current = other._current;
+	}
+	_pages.reserve(_pages.size() + other._pages.size());
+	std::move(other._pages.begin(), other._pages.end(), std::back_inserter(_pages));
+	other.Clear();
+	return base;
+}
+
+void TextArena::Compress()
+{
+#ifdef HAVE_ZSTD
+	for (size_t n = 0; n < _pages.size(); ++n)
+	{
+		Page& page = _pages[n];
+		if (n == _current || page.IsPacked() || page.text.empty())
+		{
+			continue;
+		}
+		std::vector<char> packed(::ZSTD_compressBound(page.text.size()));
+		size_t size = ::ZSTD_compress(packed.data(), packed.size(), page.text.data(), page.text.size(), COMPRESSION_LEVEL);
+		if (::ZSTD_isError(size))
+		{
+			continue;
+		}
+		packed.resize(size);
+		packed.shrink_to_fit();
+		page.packed.swap(packed);
+		page.size = page.text.size();
+		std::vector<char>().swap(page.text);
+		page.id = ++s_pageIds;
+	}
+#endif // HAVE_ZSTD
+}
+
+bool TextArena::IsCompressionAvailable()
+{
+#ifdef HAVE_ZSTD
+	return true;
+#else
+	return false;
+#endif // HAVE_ZSTD
+}
+
+void TextArena::Clear()
+{
+	std::vector<Page>().swap(_pages);
+	_current = 0;
+}
+
+//
+// Text table
+//
+
+TextRef TextTable::Intern(TextArena& arena, StrView text, size_t count)
+{
+	if (text.empty())
+	{
+		return 0;
+	}
+	size_t hash = wxStringCache::Hash(text);
+	std::string buffer;
+	auto range = _refs.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		StrView stored = arena.Get(it->second, buffer);
+		if (stored.size() == text.size() && memcmp(stored.begin, text.begin, text.size()) == 0)
+		{
+			_counts[it->second] += count;
+			return it->second;
+		}
+	}
+	TextRef ref = arena.Add(text);
+	_refs.emplace(hash, ref);
+	_counts[ref] = count;
+	return ref;
+}
+
+TextRef TextTable::Append(TextArena& arena, TextRef ref, StrView text)
+{
+	if (text.empty())
+	{
+		return ref;
+	}
+	std::string buffer;
+	StrView previous = arena.Get(ref, buffer);
+	std::string str(previous.begin, previous.size());
+	str.append(text.begin, text.size());
+	Release(ref);
+	return Intern(arena, StrView(str.data(), str.data() + str.size()));
+}
+
+void TextTable::Release(TextRef ref, size_t count)
+{
+	auto it = _counts.find(ref);
+	if (it != _counts.end())
+	{
+		// Kept with a null count, the text may be referenced again.
+		it->second -= std::min(count, it->second);
+	}
+}
+
+size_t TextTable::GetCount(TextRef ref)const
+{
+	auto it = _counts.find(ref);
+	return it != _counts.end() ? it->second : 0;
+}
+
+
 //
 // File Descriptor
 //
@@ -60,6 +397,42 @@ wxString FileDescriptor::StatusToString(FILE_DESC_STATUS status)
 	return arr[status];
 }
 
+void FileDescriptor::Stamp()
+{
+	if (offset == UNKNOWN_OFFSET)
+	{
+		return;
+	}
+	wxFileName name(path);
+	wxULongLong length = name.GetSize();
+	size = length != wxInvalidSize ? length.GetValue() : 0;
+	modified = name.GetModificationTime();
+	fingerprint = FileReader::Fingerprint(path, offset);
+}
+
+bool FileDescriptor::IsUnchanged()const
+{
+	if (offset == UNKNOWN_OFFSET || offset != size)
+	{
+		return false;
+	}
+	wxFileName name(path);
+	wxULongLong length = name.GetSize();
+	return length != wxInvalidSize && length.GetValue() == size
+		&& modified.IsValid() && name.GetModificationTime() == modified;
+}
+
+bool FileDescriptor::IsPrefixUnchanged()const
+{
+	if (offset == UNKNOWN_OFFSET || fingerprint == 0)
+	{
+		return false;
+	}
+	wxULongLong length = wxFileName::GetSize(path);
+	return length != wxInvalidSize && length.GetValue() >= offset
+		&& FileReader::Fingerprint(path, offset) == fingerprint;
+}
+
 
 //
 // FileData
@@ -117,145 +490,998 @@ void FileData::ClearStatistics()
 }
 
 //
-// Log database
+// Parallel date sort
 //
 
-LogData::LogData(FileData& fileData):
-_fileData(fileData)
-{
-}
+// Minimal count of entries worth a thread
+static const size_t PARALLEL_SLICE = 64 * 1024;
 
-void LogData::Clear()
+// Run function(n) for n in [0, count), each on its own thread.
+template<typename Function>
+static void RunParallel(size_t count, Function function)
 {
-	_entries.clear();
-	Synchronize();
+	std::vector<std::thread> threads;
+	for (size_t n = 1; n < count; ++n)
+	{
+		threads.emplace_back(function, n);
+	}
+	function(0);
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
 }
 
-void LogData::AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, wxString thread, wxString logger, wxString source, wxString message)
+// Stable LSD radix sort on the first bytes of keys, 8 bits at a time.
+// Each thread counts then scatters its own slice of keys, slices being
+// ordered the sort stays stable.
+template<typename Key, typename Digit>
+static void RadixSort(std::vector<Key>& keys, size_t bytes, size_t threads, Digit digit)
 {
-	AddLog(date, file, criticality,
-		_threads.Get(thread.Trim(false).Trim(true)),
-		_loggers.Get(logger.Trim(false).Trim(true)),
-		_sources.Get(source.Trim(false).Trim(true)),
-		message.Trim(false).Trim(true));
-}
+	std::vector<Key> sorted(keys.size());
+	std::vector<std::array<size_t, 256>> offsets(threads);
+	auto begin = [&](size_t thread) { return keys.size() * thread / threads; };
 
-void LogData::AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, long thread, long logger, long source, const wxString& message)
-{
-	_entries.push_back({
-		date,
-		file,
-		criticality,
-		thread,
-		logger,
-		source,
-		message
+	for (size_t byte = 0; byte < bytes; ++byte)
+	{
+		RunParallel(threads, [&](size_t thread)
+		{
+			std::array<size_t, 256>& counts = offsets[thread];
+			counts.fill(0);
+			for (size_t n = begin(thread); n < begin(thread + 1); ++n)
+			{
+				counts[digit(keys[n], byte)]++;
+			}
 		});
-}
 
-void LogData::Synchronize()
-{
-	SortLogsByDate();
-	SortAndReindexColumns();
-	UpdateStatistics();
-	NotifyUpdate();
+		// Digit major, thread minor
+		size_t offset = 0;
+		for (size_t value = 0; value < 256; ++value)
+		{
+			for (size_t thread = 0; thread < threads; ++thread)
+			{
+				size_t count = offsets[thread][value];
+				offsets[thread][value] = offset;
+				offset += count;
+			}
+		}
+
+		RunParallel(threads, [&](size_t thread)
+		{
+			std::array<size_t, 256>& positions = offsets[thread];
+			for (size_t n = begin(thread); n < begin(thread + 1); ++n)
+			{
+				sorted[positions[digit(keys[n], byte)]++] = keys[n];
+			}
+		});
+		keys.swap(sorted);
+	}
 }
 
-void LogData::SortLogsByDate()
+/**
+ * Stable order of entries by date from the first one, entries without date first.
+ * Timestamps are made relative to the oldest one so only the bytes
+ * spanning the dates are sorted.
+ */
+static std::vector<size_t> SortByDate(const std::vector<int64_t>& dates, size_t first)
 {
-	std::sort(/*std::execution::par_unseq,*/ _entries.begin(), _entries.end(),
-		[](const Entry& a, const Entry& b)->bool
+	const size_t count = dates.size() - first;
+	const size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count / PARALLEL_SLICE));
+	auto begin = [&](size_t thread) { return count * thread / threads; };
+
+	int64_t min = INT64_MAX, max = INT64_MIN;
+	for (size_t n = first; n < dates.size(); ++n)
 	{
-		return a.date < b.date;
-	});
+		int64_t date = dates[n];
+		if (date != LogData::INVALID_DATE)
+		{
+			min = std::min(min, date);
+			max = std::max(max, date);
+		}
+	}
+	// Entries without date have key 0.
+	auto key = [&](size_t n)->uint64_t
+	{
+		int64_t date = dates[first + n];
+		return date != LogData::INVALID_DATE ? (uint64_t)date - (uint64_t)min + 1 : 0;
+	};
+	uint64_t span = min <= max ? (uint64_t)max - (uint64_t)min + 1 : 0;
+	size_t bytes = 0;
+	while (bytes < 8 && (span >> (bytes * 8)) != 0)
+	{
+		++bytes;
+	}
+
+	std::vector<size_t> order(count);
+	if (span <= 0xFFFFFFFF && count <= 0xFFFFFFFF)
+	{
+		// Key and index packed together
+		std::vector<uint64_t> keys(count);
+		RunParallel(threads, [&](size_t thread)
+		{
+			for (size_t n = begin(thread); n < begin(thread + 1); ++n)
+			{
+				keys[n] = (key(n) << 32) | n;
+			}
+		});
+		RadixSort(keys, bytes, threads, [](uint64_t k, size_t byte) { return (k >> (32 + byte * 8)) & 0xFF; });
+		RunParallel(threads, [&](size_t thread)
+		{
+			for (size_t n = begin(thread); n < begin(thread + 1); ++n)
+			{
+				order[n] = first + (keys[n] & 0xFFFFFFFF);
+			}
+		});
+	}
+	else
+	{
+		struct DateKey
+		{
+			uint64_t key;
+			size_t index;
+		};
+		std::vector<DateKey> keys(count);
+		RunParallel(threads, [&](size_t thread)
+		{
+			for (size_t n = begin(thread); n < begin(thread + 1); ++n)
+			{
+				keys[n] = { key(n), n };
+			}
+		});
+		RadixSort(keys, bytes, threads, [](const DateKey& k, size_t byte) { return (k.key >> (byte * 8)) & 0xFF; });
+		RunParallel(threads, [&](size_t thread)
+		{
+			for (size_t n = begin(thread); n < begin(thread + 1); ++n)
+			{
+				order[n] = first + keys[n].index;
+			}
+		});
+	}
+	return order;
 }
 
-void LogData::SortAndReindexColumns()
+// Beyond, entries are sorted rather than merged.
+static const size_t MAX_STRAGGLER_RATIO = 8;
+
+/**
+ * Stable order by date of entries from the first one, when they are mostly ordered.
+ * Entries older than previous ones (stragglers) are sorted apart and merged back.
+ * Return false when there are too many stragglers for merging to be worth it.
+ */
+static bool MergeByDate(const std::vector<int64_t>& dates, size_t first, std::vector<size_t>& order)
 {
-	auto reindex = [](const std::vector<wxString>& before, const std::vector<wxString>& after) ->std::vector<int>
+	const size_t count = dates.size();
+	std::vector<size_t> ordered, stragglers;
+	ordered.reserve(count - first);
+	int64_t last = LogData::INVALID_DATE;
+	for (size_t n = first; n < count; ++n)
 	{
-		std::vector<int> reindex;
-		for (int i = 0; i < before.size(); ++i)
+		if (dates[n] >= last)
+		{
+			ordered.push_back(n);
+			last = dates[n];
+		}
+		else
 		{
-			for (int pos = 0; pos < after.size(); ++pos)
+			stragglers.push_back(n);
+			if (stragglers.size() > (count - first) / MAX_STRAGGLER_RATIO)
 			{
-				if (before[i] == after[pos])
-				{
-					reindex.push_back(pos);
-					break;
-				}
+				return false;
 			}
 		}
-		return reindex;
-	};
-
-	std::vector<wxString> loggers = _loggers;
-	std::sort(/*std::execution::par_unseq,*/ loggers.begin(), loggers.end());
-	std::vector<int> reindexLoggers = reindex(_loggers, loggers);
-
-	std::vector<wxString> sources = _sources;
-	std::sort(/*std::execution::par_unseq,*/ sources.begin(), sources.end());
-	std::vector<int> reindexSources = reindex(_sources, sources);
-
-	std::vector<wxString> threads = _threads;
-	std::sort(/*std::execution::par_unseq,*/ threads.begin(), threads.end());
-	std::vector<int> reindexThreads = reindex(_threads, threads);
+	}
+	std::stable_sort(stragglers.begin(), stragglers.end(), [&](size_t a, size_t b)
+	{
+		return dates[a] < dates[b];
+	});
 
-	for (Entry& entry : _entries)
+	// Equal dates are ordered by index to keep the sort stable.
+	order.resize(count - first);
+	std::merge(ordered.begin(), ordered.end(), stragglers.begin(), stragglers.end(), order.begin(), [&](size_t a, size_t b)
 	{
-		entry.logger = reindexLoggers[entry.logger];
-		entry.source = reindexSources[entry.source];
-		entry.thread = reindexThreads[entry.thread];
-	}
+		return dates[a] != dates[b] ? dates[a] < dates[b] : a < b;
+	});
+	return true;
+}
 
-	std::swap(_loggers, loggers);
-	std::swap(_sources, sources);
-	std::swap(_threads, threads);
+// Give freed memory back to the system.
+static void ReleaseMemory()
+{
+#if defined(__GLIBC__)
+	malloc_trim(0);
+#endif
 }
 
 
-void LogData::UpdateStatistics()
-{
-	_criticalityCounts = { 0, 0, 0, 0, 0, 0, 0, 0 };
-	_loggersEntryCount.clear();
-	_loggersEntryCount.resize(_loggers.size(), 0);
-	_criticalityLoggerCounts.clear();
-	_criticalityLoggerCounts.resize(_loggers.size(), { 0, 0, 0, 0, 0, 0, 0, 0 });
+//
+// Log database
+//
 
-	GetFileData().ClearStatistics();
+LogData::LogData(FileData& fileData):
+_fileData(fileData)
+{
+}
 
-	for (auto& entry : _entries)
+LogData::FileSegment& LogData::GetSegment(uint16_t file)
+{
+	if (file >= _segments.size())
 	{
-		_loggersEntryCount[entry.logger]++;
-		_criticalityCounts[entry.criticality]++;
-		_criticalityLoggerCounts[entry.logger][entry.criticality]++;
+		_segments.resize(file + 1);
+	}
+	return _segments[file];
+}
 
-		FileDescriptor& fd = GetFileData().GetFile(entry.file);
-		fd.entryCount++;
-		fd.criticalityCounts[entry.criticality]++;
+size_t LogData::FindRow(uint64_t ref)const
+{
+	// Among entries of the same date
+	const int64_t date = GetDate(ref);
+	size_t row = LowerBound(date);
+	while (row < EntryCount() && _index[row] != ref && GetDate(_index[row]) == date)
+	{
+		++row;
+	}
+	return row;
+}
+
+void LogData::RemoveTail(uint16_t file)
+{
+	FileSegment& segment = _segments[file];
+	if (!segment.tail)
+	{
+		return;
+	}
+	segment.tail = false;
+
+	if (segment.size() > segment.tailSize)
+	{
+		if (segment.synchronized > segment.tailSize)
+		{
+			// Already in the index
+			std::vector<uint32_t> rows;
+			for (size_t entry = segment.tailSize; entry < segment.synchronized; ++entry)
+			{
+				rows.push_back((uint32_t)FindRow(MakeRef(file, entry)));
+			}
+			std::sort(rows.begin(), rows.end());
+			for (auto row = rows.rbegin(); row != rows.rend(); ++row)
+			{
+				_index.erase(_index.begin() + *row);
+			}
+			EraseRows(rows);
+			_changes.removed += rows.size();
+			_changes.inserted.clear();
+			segment.synchronized = segment.tailSize;
+		}
+		UpdateStatistics(file, segment.tailSize, segment.size(), -1);
+		for (size_t entry = segment.tailSize; entry < segment.size(); ++entry)
+		{
+			segment.extraTable.Release(segment.extras[entry]);
+		}
+		segment.dates.resize(segment.tailSize);
+		segment.criticalities.resize(segment.tailSize);
+		segment.threadIds.resize(segment.tailSize);
+		segment.loggerIds.resize(segment.tailSize);
+		segment.sourceIds.resize(segment.tailSize);
+		segment.messages.resize(segment.tailSize);
+		segment.extras.resize(segment.tailSize);
+	}
+
+	// The last line may also have continued the extra of the previous entry.
+	if (segment.tailSize > 0 && segment.extras.back() != segment.tailExtra)
+	{
+		std::string buffer;
+		segment.extraTable.Release(segment.extras.back());
+		segment.extras.back() = segment.extraTable.Intern(segment.texts, segment.texts.Get(segment.tailExtra, buffer));
+		if (segment.synchronized == segment.size())
+		{
+			_updated.push_back(MakeRef(file, segment.size() - 1));
+		}
+	}
+}
+
+void LogData::Clear()
+{
+	_changes.removed += EntryCount();
+	_changes.inserted.clear();
+	_updated.clear();
+	std::vector<FileSegment>().swap(_segments);
+	std::vector<uint64_t>().swap(_index);
+	_indexedRows = 0;
+	UpdateStatistics();
+	ReleaseMemory();
+	Synchronize();
+}
+
+void LogData::AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, wxString thread, wxString logger, wxString source, wxString message)
+{
+	wxScopedCharBuffer utf8 = message.Trim(false).Trim(true).utf8_str();
+	AddLog(date, file, criticality,
+		_threads.Get(thread.Trim(false).Trim(true)),
+		_loggers.Get(logger.Trim(false).Trim(true)),
+		_sources.Get(source.Trim(false).Trim(true)),
+		StrView(utf8.data(), utf8.data() + utf8.length()));
+}
+
+void LogData::AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, StrView thread, StrView logger, StrView source, StrView message)
+{
+	AddLog(date, file, criticality,
+		_threads.Get(thread),
+		_loggers.Get(logger),
+		_sources.Get(source),
+		message);
+}
+
+void LogData::AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, long thread, long logger, long source, StrView message)
+{
+	FileSegment& segment = GetSegment(file);
+	segment.dates.push_back(ToTimestamp(date));
+	segment.criticalities.push_back((uint8_t)criticality);
+	segment.threadIds.push_back(thread);
+	segment.loggerIds.push_back(logger);
+	segment.sourceIds.push_back(source);
+	segment.messages.push_back(segment.texts.Add(message));
+	segment.extras.push_back(0);
+	UpdateStatistics(file, segment.size() - 1, segment.size(), 1);
+}
+
+Entry LogData::GetEntry(size_t index)const
+{
+	return {
+		GetEntryDate(index),
+		GetEntryFile(index),
+		GetEntryCriticality(index),
+		GetEntryThread(index),
+		GetEntryLogger(index),
+		GetEntrySource(index),
+		GetEntryMessage(index),
+		GetEntryExtra(index)
+		};
+}
+
+void LogData::Append(LogShard&& shard)
+{
+	FileSegment& segment = GetSegment(shard.file);
+
+	// Lines parsed again from the unterminated last one replace it.
+	RemoveTail(shard.file);
+	if (shard.tail)
+	{
+		segment.tail = true;
+		segment.tailSize = segment.size();
+		segment.tailExtra = segment.size() > 0 ? segment.extras.back() : 0;
+	}
+
+	// Leading extra lines continue the last entry appended from the file, wherever sorting put it.
+	if (!shard.leadingExtra.empty() && segment.size() > 0)
+	{
+		const std::string& extra = shard.leadingExtra;
+		segment.extras.back() = segment.extraTable.Append(segment.texts, segment.extras.back(), StrView(extra.data(), extra.data() + extra.size()));
+		if (segment.synchronized == segment.size())
+		{
+			// Already displayed
+			_updated.push_back(MakeRef(shard.file, segment.size() - 1));
+		}
+	}
+	shard.leadingExtra.clear();
+
+	// Shard texts are moved as a whole, their references only have to be shifted.
+	TextRef base = segment.texts.Adopt(std::move(shard.texts));
+	auto rebase = [base](TextRef ref)->TextRef
+	{
+		return ref != 0 ? ref + base : 0;
+	};
+
+	auto remap = [](const wxStringCache& from, wxStringCache& to)->std::vector<long>
+	{
+		std::vector<long> ids;
+		ids.reserve(from.size());
+		for (const wxString& str : from)
+		{
+			ids.push_back(to.Get(str));
+		}
+		return ids;
+	};
+
+	std::vector<long> threads = remap(shard.threads, _threads);
+	std::vector<long> loggers = remap(shard.loggers, _loggers);
+	std::vector<long> sources = remap(shard.sources, _sources);
+
+	// Only extras not already known from the file are copied.
+	std::unordered_map<TextRef, TextRef> extras;
+	std::string buffer;
+	for (const auto& extra : shard.extraTable)
+	{
+		if (extra.second > 0)
+		{
+			extras[extra.first] = segment.extraTable.Intern(segment.texts, shard.extras.Get(extra.first, buffer), extra.second);
+		}
+	}
+	shard.extras.Clear();
+
+	size_t first = segment.size();
+	size_t count = first + shard.entries.size();
+	segment.dates.reserve(count);
+	segment.criticalities.reserve(count);
+	segment.threadIds.reserve(count);
+	segment.loggerIds.reserve(count);
+	segment.sourceIds.reserve(count);
+	segment.messages.reserve(count);
+	segment.extras.reserve(count);
+	for (const ShardEntry& entry : shard.entries)
+	{
+		segment.dates.push_back(ToTimestamp(entry.date));
+		segment.criticalities.push_back((uint8_t)entry.criticality);
+		segment.threadIds.push_back(threads[entry.thread]);
+		segment.loggerIds.push_back(loggers[entry.logger]);
+		segment.sourceIds.push_back(sources[entry.source]);
+		segment.messages.push_back(rebase(entry.message));
+		segment.extras.push_back(entry.extra != 0 ? extras[entry.extra] : 0);
+	}
+	UpdateStatistics(shard.file, first, count, 1);
+	shard.entries.clear();
+}
+
+void LogData::Extend(uint16_t file, LogShard&& shard)
+{
+	shard.file = file;
+	Append(std::move(shard));
+	Synchronize();
+}
+
+void LogData::Synchronize()
+{
+	if (IsTextCompressed())
+	{
+		for (FileSegment& segment : _segments)
+		{
+			if (segment.synchronized < segment.size())
+			{
+				segment.texts.Compress();
+			}
+		}
+	}
+	SortLogsByDate();
+	SortAndReindexColumns();
+	UpdateRows();
+	ReportUpdates();
+	if (!_changes.IsEmpty())
+	{
+		NotifyChanges();
+	}
+	_changes = LogChanges();
+}
+
+void LogData::ReportUpdates()
+{
+	if (!_changes.IsReset())
+	{
+		for (uint64_t ref : _updated)
+		{
+			size_t row = FindRow(ref);
+			if (row < EntryCount() && _index[row] == ref)
+			{
+				_changes.updated.push_back(row);
+			}
+		}
+		std::sort(_changes.updated.begin(), _changes.updated.end());
+		_changes.updated.erase(std::unique(_changes.updated.begin(), _changes.updated.end()), _changes.updated.end());
+	}
+	_updated.clear();
+}
+
+void LogData::SortLogsByDate()
+{
+	// New entries of each file, by date.
+	std::vector<std::vector<uint64_t>> runs(1);
+	int64_t oldest = INT64_MAX;
+	for (size_t file = 0; file < _segments.size(); ++file)
+	{
+		FileSegment& segment = _segments[file];
+		const size_t first = segment.synchronized;
+		if (first == segment.size())
+		{
+			continue;
+		}
+		std::vector<size_t> order;
+		if (std::is_sorted(segment.dates.begin() + first, segment.dates.end()))
+		{
+			order.resize(segment.size() - first);
+			std::iota(order.begin(), order.end(), first);
+		}
+		else if (!MergeByDate(segment.dates, first, order))
+		{
+			order = SortByDate(segment.dates, first);
+		}
+		runs.emplace_back();
+		runs.back().reserve(order.size());
+		for (size_t entry : order)
+		{
+			runs.back().push_back(MakeRef(file, entry));
+		}
+		oldest = std::min(oldest, segment.dates[order.front()]);
+		segment.synchronized = segment.size();
+	}
+	if (runs.size() == 1)
+	{
+		return;
+	}
 
-		/* TODO, count filtered criticalities by loggers, threads and sources */
+	// Indexed entries up to the oldest new one stay in place, the following ones are merged as the first run.
+	size_t first = std::upper_bound(_index.begin(), _index.end(), oldest, [this](int64_t date, uint64_t ref)
+	{
+		return date < GetDate(ref);
+	}) - _index.begin();
+	const size_t former = _index.size();
+	runs.front().assign(_index.begin() + first, _index.end());
+	_index.resize(first);
+	_indexedRows = std::min(_indexedRows, first);
+
+	// K-way merge, equal dates being ordered by run to keep indexed entries before new ones.
+	struct Head
+	{
+		size_t run, pos;
+	};
+	auto after = [&](const Head& a, const Head& b)->bool
+	{
+		int64_t da = GetDate(runs[a.run][a.pos]), db = GetDate(runs[b.run][b.pos]);
+		return da != db ? da > db : a.run > b.run;
+	};
+	std::vector<Head> heap;
+	size_t count = first;
+	for (size_t run = 0; run < runs.size(); ++run)
+	{
+		if (!runs[run].empty())
+		{
+			heap.push_back({ run, 0 });
+			count += runs[run].size();
+		}
+	}
+	std::make_heap(heap.begin(), heap.end(), after);
+
+	_index.reserve(count);
+	if (count - former > former)
+	{
+		// More new entries than former ones, as when loading: cheaper to handle as a whole.
+		_changes.reset = true;
+		_changes.inserted.clear();
+	}
+	const bool report = !_changes.IsReset();
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), after);
+		Head& head = heap.back();
+		if (report && head.run > 0)
+		{
+			// Report where new entries went.
+			_changes.inserted.push_back(_index.size());
+		}
+		_index.push_back(runs[head.run][head.pos]);
+		if (++head.pos < runs[head.run].size())
+		{
+			std::push_heap(heap.begin(), heap.end(), after);
+		}
+		else
+		{
+			heap.pop_back();
+		}
+	}
+}
+
+void LogData::SortAndReindexColumns()
+{
+	std::vector<long> loggers, sources, threads;
+	bool sorted = _loggers.Sort(loggers);
+	sorted = _sources.Sort(sources) || sorted;
+	sorted = _threads.Sort(threads) || sorted;
+	if (!sorted)
+	{
+		// Ids did not change
+		return;
+	}
+
+	auto reindex = [](std::vector<uint32_t>& ids, const std::vector<long>& reindex)
+	{
+		if (!reindex.empty())
+		{
+			for (uint32_t& id : ids)
+			{
+				id = reindex[id];
+			}
+		}
+	};
+	for (FileSegment& segment : _segments)
+	{
+		reindex(segment.loggerIds, loggers);
+		reindex(segment.sourceIds, sources);
+		reindex(segment.threadIds, threads);
+	}
+
+	// Statistics by label follow their ids.
+	auto restat = [](std::vector<CriticalityCounts>& counts, const std::vector<long>& reindex)
+	{
+		if (!reindex.empty())
+		{
+			std::vector<CriticalityCounts> reindexed(std::max(counts.size(), reindex.size()));
+			for (size_t id = 0; id < reindex.size() && id < counts.size(); ++id)
+			{
+				reindexed[reindex[id]] = counts[id];
+			}
+			counts.swap(reindexed);
+		}
+	};
+	restat(_criticalityLoggerCounts, loggers);
+	restat(_criticalitySourceCounts, sources);
+	restat(_criticalityThreadCounts, threads);
+
+	// So do their rows.
+	auto rerow = [](std::vector<Bitmap>& rows, const std::vector<long>& reindex)
+	{
+		if (!reindex.empty())
+		{
+			std::vector<Bitmap> reindexed(std::max(rows.size(), reindex.size()));
+			for (size_t id = 0; id < reindex.size() && id < rows.size(); ++id)
+			{
+				reindexed[reindex[id]] = std::move(rows[id]);
+			}
+			rows.swap(reindexed);
+		}
+	};
+	rerow(_loggerRows, loggers);
+	rerow(_threadRows, threads);
+
+	_changes.threads.swap(threads);
+	_changes.loggers.swap(loggers);
+	_changes.sources.swap(sources);
+}
+
+void LogData::SetTextCompression(bool compress)
+{
+	_compressTexts = compress && TextArena::IsCompressionAvailable();
+	if (_compressTexts)
+	{
+		for (FileSegment& segment : _segments)
+		{
+			segment.texts.Compress();
+		}
+	}
+}
+
+void LogData::RemoveFileLogs(const std::vector<uint16_t>& files)
+{
+	// Segments of removed files are dropped as a whole.
+	std::vector<bool> removed(_segments.size(), false);
+	bool any = false;
+	for (uint16_t file : files)
+	{
+		if (file < _segments.size() && _segments[file].size() > 0)
+		{
+			UpdateStatistics(file, 0, _segments[file].size(), -1);
+			_segments[file] = FileSegment();
+			removed[file] = any = true;
+		}
+	}
+	if (!any)
+	{
+		return;
+	}
+
+	// Only references to their entries are removed from the index, and their rows from the bitmaps.
+	std::vector<uint32_t> rows;
+	for (size_t n = 0; n < _index.size(); ++n)
+	{
+		if (removed[_index[n] >> FILE_SHIFT])
+		{
+			rows.push_back((uint32_t)n);
+		}
+	}
+	_index.erase(std::remove_if(_index.begin(), _index.end(), [&](uint64_t ref)
+	{
+		return removed[ref >> FILE_SHIFT];
+	}), _index.end());
+	if (_index.size() < _index.capacity() / 2)
+	{
+		_index.shrink_to_fit();
+	}
+	for (size_t file = 0; file < _fileRows.size() && file < removed.size(); ++file)
+	{
+		if (removed[file])
+		{
+			_fileRows[file].Clear();
+		}
+	}
+	EraseRows(rows);
+	_changes.removed += rows.size();
+	_changes.inserted.clear();
+	_updated.clear();
+	ReleaseMemory();
+}
+
+void LogData::RenumberFiles(const std::vector<long>& ids)
+{
+	size_t count = 0;
+	bool renumbered = false;
+	for (size_t file = 0; file < ids.size(); ++file)
+	{
+		if (ids[file] != wxNOT_FOUND)
+		{
+			++count;
+		}
+		renumbered = renumbered || ids[file] != (long)file;
+	}
+	if (!renumbered)
+	{
+		return;
+	}
+
+	std::vector<FileSegment> segments(count);
+	for (size_t file = 0; file < ids.size() && file < _segments.size(); ++file)
+	{
+		if (ids[file] != wxNOT_FOUND)
+		{
+			segments[ids[file]] = std::move(_segments[file]);
+		}
+	}
+	_segments.swap(segments);
+	std::vector<Bitmap> rows(count);
+	for (size_t file = 0; file < ids.size() && file < _fileRows.size(); ++file)
+	{
+		if (ids[file] != wxNOT_FOUND)
+		{
+			rows[ids[file]] = std::move(_fileRows[file]);
+		}
+	}
+	_fileRows.swap(rows);
+	for (uint64_t& ref : _index)
+	{
+		ref = MakeRef(ids[ref >> FILE_SHIFT], ref & ENTRY_MASK);
+	}
+	for (uint64_t& ref : _updated)
+	{
+		ref = MakeRef(ids[ref >> FILE_SHIFT], ref & ENTRY_MASK);
+	}
+	_changes.files = ids;
+}
+
+const Bitmap& LogData::Rows(const std::vector<Bitmap>& rows, size_t id)
+{
+	static const Bitmap empty;
+	return id < rows.size() ? rows[id] : empty;
+}
+
+void LogData::UpdateRows()
+{
+	const size_t first = std::min(_indexedRows, EntryCount());
+	const size_t count = EntryCount() - first;
+	_indexedRows = EntryCount();
+
+	_threadRows.resize(GetThreadCount());
+	_loggerRows.resize(GetLoggerCount());
+	_fileRows.resize(_segments.size());
+
+	// Each kind of bitmap is updated on its own thread.
+	auto update = [&](std::vector<Bitmap>& rows, auto id)
+	{
+		for (Bitmap& bitmap : rows)
+		{
+			bitmap.Truncate(first);
+		}
+		for (size_t n = first; n < EntryCount(); ++n)
+		{
+			rows[id(_index[n])].Add(n);
+		}
+	};
+	std::function<void(size_t)> tasks[] = {
+		[&](size_t)
+		{
+			for (Bitmap& bitmap : _criticalityRows)
+			{
+				bitmap.Truncate(first);
+			}
+			for (size_t n = first; n < EntryCount(); ++n)
+			{
+				_criticalityRows[Column(&FileSegment::criticalities, n)].Add(n);
+			}
+		},
+		[&](size_t)
+		{
+			update(_threadRows, [this](uint64_t ref) { return _segments[ref >> FILE_SHIFT].threadIds[ref & ENTRY_MASK]; });
+		},
+		[&](size_t)
+		{
+			update(_loggerRows, [this](uint64_t ref) { return _segments[ref >> FILE_SHIFT].loggerIds[ref & ENTRY_MASK]; });
+		},
+		[&](size_t)
+		{
+			update(_fileRows, [](uint64_t ref) { return ref >> FILE_SHIFT; });
+		}
+	};
+	const size_t threads = count >= PARALLEL_SLICE ? 4 : 1;
+	RunParallel(threads, [&](size_t thread)
+	{
+		for (size_t task = thread; task < 4; task += threads)
+		{
+			tasks[task](task);
+		}
+	});
+}
+
+void LogData::EraseRows(const std::vector<uint32_t>& rows)
+{
+	if (rows.empty())
+	{
+		return;
+	}
+	std::vector<Bitmap*> bitmaps;
+	for (std::vector<Bitmap>* rowsById : { &_threadRows, &_loggerRows, &_fileRows })
+	{
+		for (Bitmap& bitmap : *rowsById)
+		{
+			bitmaps.push_back(&bitmap);
+		}
+	}
+	for (Bitmap& bitmap : _criticalityRows)
+	{
+		bitmaps.push_back(&bitmap);
+	}
+
+	std::atomic<size_t> next(0);
+	const size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), rows.size() / PARALLEL_SLICE));
+	RunParallel(threads, [&](size_t)
+	{
+		for (size_t n = next++; n < bitmaps.size(); n = next++)
+		{
+			bitmaps[n]->Erase(rows);
+		}
+	});
+	_indexedRows -= std::lower_bound(rows.begin(), rows.end(), _indexedRows) - rows.begin();
+}
+
+void LogData::UpdateStatistics()
+{
+	_criticalityCounts = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	// Labels without entries are counted too.
+	_criticalityLoggerCounts.assign(GetLoggerCount(), CriticalityCounts{});
+	_criticalityThreadCounts.assign(GetThreadCount(), CriticalityCounts{});
+	_criticalitySourceCounts.assign(GetSourceCount(), CriticalityCounts{});
+
+	GetFileData().ClearStatistics();
+
+	for (size_t file = 0; file < _segments.size(); ++file)
+	{
+		UpdateStatistics(file, 0, _segments[file].size(), 1);
+	}
+}
+
+// Count entries in histograms by criticality, for all of them and by label.
+// Increment is 1 or (wrapping) -1.
+static void CountEntries(const std::vector<uint8_t>& criticalities, const std::vector<uint32_t>& loggerIds,
+	const std::vector<uint32_t>& threadIds, const std::vector<uint32_t>& sourceIds, size_t first, size_t last, size_t increment,
+	CriticalityCounts& counts, std::vector<CriticalityCounts>& loggers, std::vector<CriticalityCounts>& threads, std::vector<CriticalityCounts>& sources)
+{
+	for (size_t n = first; n < last; ++n)
+	{
+		uint8_t criticality = criticalities[n];
+		counts[criticality] += increment;
+		loggers[loggerIds[n]][criticality] += increment;
+		threads[threadIds[n]][criticality] += increment;
+		sources[sourceIds[n]][criticality] += increment;
+	}
+}
+
+void LogData::UpdateStatistics(uint16_t file, size_t first, size_t last, long increment)
+{
+	_criticalityLoggerCounts.resize(_loggers.size());
+	_criticalityThreadCounts.resize(_threads.size());
+	_criticalitySourceCounts.resize(_sources.size());
+
+	const FileSegment& segment = _segments[file];
+	const size_t count = last - first;
+	const size_t workers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count / PARALLEL_SLICE));
+	CriticalityCounts counts{};
+	if (workers == 1)
+	{
+		CountEntries(segment.criticalities, segment.loggerIds, segment.threadIds, segment.sourceIds, first, last, increment,
+			counts, _criticalityLoggerCounts, _criticalityThreadCounts, _criticalitySourceCounts);
+	}
+	else
+	{
+		// Each worker counts its slice in its own histograms, they are summed afterward.
+		struct Histograms
+		{
+			CriticalityCounts counts{};
+			std::vector<CriticalityCounts> loggers, threads, sources;
+		};
+		std::vector<Histograms> histograms(workers);
+		RunParallel(workers, [&](size_t worker)
+		{
+			Histograms& histogram = histograms[worker];
+			histogram.loggers.resize(_loggers.size());
+			histogram.threads.resize(_threads.size());
+			histogram.sources.resize(_sources.size());
+			CountEntries(segment.criticalities, segment.loggerIds, segment.threadIds, segment.sourceIds,
+				first + count * worker / workers, first + count * (worker + 1) / workers, 1,
+				histogram.counts, histogram.loggers, histogram.threads, histogram.sources);
+		});
+
+		auto reduce = [increment](std::vector<CriticalityCounts>& to, const std::vector<CriticalityCounts>& from)
+		{
+			for (size_t id = 0; id < from.size(); ++id)
+			{
+				for (size_t criticality = 0; criticality < LOG_CRITICALITY_COUNT; ++criticality)
+				{
+					to[id][criticality] += from[id][criticality] * (size_t)increment;
+				}
+			}
+		};
+		for (const Histograms& histogram : histograms)
+		{
+			for (size_t criticality = 0; criticality < LOG_CRITICALITY_COUNT; ++criticality)
+			{
+				counts[criticality] += histogram.counts[criticality] * (size_t)increment;
+			}
+			reduce(_criticalityLoggerCounts, histogram.loggers);
+			reduce(_criticalityThreadCounts, histogram.threads);
+			reduce(_criticalitySourceCounts, histogram.sources);
+		}
+	}
+
+	// Entries all come from the file.
+	FileDescriptor& fd = GetFileData().GetFile(file);
+	for (size_t criticality = 0; criticality < LOG_CRITICALITY_COUNT; ++criticality)
+	{
+		_criticalityCounts[criticality] += counts[criticality];
+		fd.criticalityCounts[criticality] += counts[criticality];
+		fd.entryCount += counts[criticality];
+	}
+}
+
+void LogData::NotifyChanges()
+{
+	for (auto listener : _listeners)
+	{
+		listener->Changed(*this, _changes);
+	}
+}
+
+
+// Index of the first entry for which before(timestamp) is false, entries being sorted by date.
+template<typename Before>
+static size_t FindBound(const LogData& data, Before before)
+{
+	size_t low = 0, high = data.EntryCount();
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (before(data.GetEntryTimestamp(middle)))
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
 	}
+	return low;
 }
 
-void LogData::NotifyUpdate()
+size_t LogData::LowerBound(int64_t timestamp)const
 {
-	for (auto listener : _listeners)
-	{
-		listener->Updated(*this);
-	}
+	return FindBound(*this, [timestamp](int64_t date) { return date < timestamp; });
 }
 
-
+size_t LogData::UpperBound(int64_t timestamp)const
+{
+	return FindBound(*this, [timestamp](int64_t date) { return date <= timestamp; });
+}
 
 wxDateTime LogData::GetBeginDate()const
 {
-	return EntryCount()>0 ? GetEntry(0).date : wxDateTime();
+	return EntryCount()>0 ? GetEntryDate(0) : wxDateTime();
 }
 
 wxDateTime LogData::GetEndDate()const
 {
-	return EntryCount()>0 ? GetEntry(EntryCount() - 1).date : wxDateTime();
+	return EntryCount()>0 ? GetEntryDate(EntryCount() - 1) : wxDateTime();
 }
 
 //
@@ -266,6 +1492,7 @@ FilteredLogData::FilteredLogData(LogData& data) :
 	_src(data)
 {
 	_src.AddListener(this);
+	Update();
 }
 
 FilteredLogData::~FilteredLogData()
@@ -276,17 +1503,108 @@ FilteredLogData::~FilteredLogData()
 
 wxDateTime FilteredLogData::GetBeginDate()const
 {
-	return EntryCount()>0 ? GetEntry(0).date : wxDateTime();
+	return EntryCount()>0 ? _src.GetEntryDate(_data.front()) : wxDateTime();
 }
 
 wxDateTime FilteredLogData::GetEndDate()const
 {
-	return EntryCount()>0 ? GetEntry(EntryCount() - 1).date : wxDateTime();
+	return EntryCount()>0 ? _src.GetEntryDate(_data.back()) : wxDateTime();
 }
 
-void FilteredLogData::Updated(LogData & data)
+void FilteredLogData::Changed(LogData & data, const LogChanges& changes)
 {
-	Update();
+	// Displayed loggers follow their ids, new ones are shown.
+	if (!changes.loggers.empty() && _shownLoggers.size() <= changes.loggers.size())
+	{
+		std::vector<bool> shown(changes.loggers.size(), true);
+		for (size_t id = 0; id < _shownLoggers.size(); ++id)
+		{
+			shown[changes.loggers[id]] = _shownLoggers[id];
+		}
+		_shownLoggers.swap(shown);
+	}
+	// Displayed files follow their renumbering.
+	if (!changes.files.empty())
+	{
+		std::vector<bool> shown(GetFileData().GetFileCount(), true);
+		for (size_t id = 0; id < _shownFiles.size() && id < changes.files.size(); ++id)
+		{
+			if (changes.files[id] != wxNOT_FOUND && (size_t)changes.files[id] < shown.size())
+			{
+				shown[changes.files[id]] = _shownFiles[id];
+			}
+		}
+		_shownFiles.swap(shown);
+	}
+	if (IsUpdating())
+	{
+		// Filtered when committing.
+		_updateReset = true;
+		return;
+	}
+	if (changes.IsReset()
+		|| _shownLoggers.size() > GetLogData().GetLoggerCount()
+		|| _shownFiles.size() > GetFileData().GetFileCount())
+	{
+		Update();
+		return;
+	}
+	_shownLoggers.resize(GetLogData().GetLoggerCount(), true);
+	_shownFiles.resize(GetFileData().GetFileCount(), true);
+
+	// Merge accepted new entries with filtered ones, moved by the insertions before them.
+	const std::vector<size_t>& inserted = changes.inserted;
+	size_t pos = inserted.empty() ? _data.size() : std::lower_bound(_data.begin(), _data.end(), inserted.front()) - _data.begin();
+	std::vector<size_t> moved(_data.begin() + pos, _data.end());
+	_data.resize(pos);
+
+	size_t next = 0;
+	auto insert = [&](size_t index)
+	{
+		if (Accept(index))
+		{
+			_data.push_back(index);
+			_criticalityCounts[_src.GetEntryCriticality(index)]++;
+		}
+	};
+	for (size_t index : moved)
+	{
+		while (next < inserted.size() && inserted[next] <= index + next)
+		{
+			insert(inserted[next++]);
+		}
+		_data.push_back(index + next);
+	}
+	while (next < inserted.size())
+	{
+		insert(inserted[next++]);
+	}
+
+	if (moved.empty())
+	{
+		// Statistics changed, even if no entry is accepted.
+		NotifyAppend(pos);
+	}
+	else
+	{
+		NotifyUpdate();
+		return;
+	}
+
+	// Filtered entries changed in place
+	std::vector<size_t> modified;
+	for (size_t index : changes.updated)
+	{
+		auto it = std::lower_bound(_data.begin(), _data.end(), (long)index);
+		if (it != _data.end() && *it == (long)index)
+		{
+			modified.push_back(it - _data.begin());
+		}
+	}
+	if (!modified.empty())
+	{
+		NotifyModify(modified);
+	}
 }
 
 void FilteredLogData::NotifyUpdate()
@@ -297,6 +1615,74 @@ void FilteredLogData::NotifyUpdate()
 	}
 }
 
+void FilteredLogData::NotifyAppend(size_t first)
+{
+	for (auto listener : _listeners)
+	{
+		listener->Appended(*this, first);
+	}
+}
+
+void FilteredLogData::NotifyModify(const std::vector<size_t>& rows)
+{
+	for (auto listener : _listeners)
+	{
+		listener->Modified(*this, rows);
+	}
+}
+
+bool FilteredLogData::Accept(size_t index)const
+{
+	int64_t date = _src.GetEntryTimestamp(index);
+	return _src.GetEntryCriticality(index) >= _criticality
+		&& (!_start.IsValid() || date >= LogData::ToTimestamp(_start))
+		&& (!_end.IsValid() || date <= LogData::ToTimestamp(_end))
+		&& _shownLoggers[_src.GetEntryLogger(index)]
+		&& _shownFiles[_src.GetEntryFile(index)];
+}
+
+// Rows of shown labels, from the union of the fewest of shown or hidden ones.
+struct LabelFilter
+{
+	std::vector<const Bitmap*> rows;
+	/** Union of rows is the one of shown labels, or of hidden ones. */
+	bool shown = true;
+	bool all = true;
+
+	template<typename LabelRows>
+	LabelFilter(const std::vector<bool>& labels, LabelRows labelRows)
+	{
+		const size_t count = std::count(labels.begin(), labels.end(), true);
+		all = count == labels.size();
+		shown = count <= labels.size() / 2;
+		for (size_t id = 0; !all && id < labels.size(); ++id)
+		{
+			if (labels[id] == shown)
+			{
+				rows.push_back(&labelRows(id));
+			}
+		}
+	}
+
+	/** Keep only shown rows of a block, positions of bitmaps being kept between increasing blocks. */
+	void Restrict(uint32_t block, uint64_t* bits, std::vector<size_t>& positions)const
+	{
+		if (all)
+		{
+			return;
+		}
+		uint64_t labels[Bitmap::BLOCK_WORDS] = {};
+		for (size_t n = 0; n < rows.size(); ++n)
+		{
+			rows[n]->OrBlock(block, labels, positions[n]);
+		}
+		for (size_t word = 0; word < Bitmap::BLOCK_WORDS; ++word)
+		{
+			bits[word] &= shown ? labels[word] : ~labels[word];
+		}
+	}
+};
+
 void FilteredLogData::Update()
 {
 	_criticalityCounts = { 0, 0, 0, 0, 0, 0, 0, 0 };
@@ -313,27 +1699,274 @@ void FilteredLogData::Update()
 		_shownFiles.resize(GetFileData().GetFileCount(), true);
 	}
 
-	_data.clear();
-	_data.reserve(_src.EntryCount());
+	const Criteria criteria = GetCriteria();
+	size_t first, last;
+	GetDateWindow(criteria.start, criteria.end, first, last);
+	const LabelFilter loggers(_shownLoggers, [this](size_t logger)->const Bitmap& { return _src.GetLoggerRows(logger); });
+	const LabelFilter files(_shownFiles, [this](size_t file)->const Bitmap& { return _src.GetFileRows(file); });
+
+	// Rows of the time frame are filtered by blocks, each thread having its own successive blocks.
+	const uint32_t firstBlock = first / Bitmap::CHUNK_SIZE;
+	const size_t blocks = first < last ? (last - 1) / Bitmap::CHUNK_SIZE + 1 - firstBlock : 0;
+	const size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), (last - first) / PARALLEL_SLICE));
+	std::vector<std::vector<uint64_t>> accepted(blocks);
+	std::vector<CriticalityCounts> counts(blocks);
+	RunParallel(threads, [&](size_t thread)
+	{
+		std::vector<size_t> loggerPositions(loggers.rows.size()), filePositions(files.rows.size());
+		std::array<size_t, LOG_CRITICALITY_COUNT> levelPositions{};
+		uint64_t rows[Bitmap::BLOCK_WORDS], level[Bitmap::BLOCK_WORDS];
+		for (size_t n = blocks * thread / threads; n < blocks * (thread + 1) / threads; ++n)
+		{
+			const uint32_t block = firstBlock + n;
+			Bitmap::FillBlock(block, rows, first, last);
+			loggers.Restrict(block, rows, loggerPositions);
+			files.Restrict(block, rows, filePositions);
+
+			// Shown criticalities, counted by level.
+			std::vector<uint64_t>& bits = accepted[n];
+			bits.assign(Bitmap::BLOCK_WORDS, 0);
+			counts[n].fill(0);
+			for (int criticality = _criticality; criticality < LOG_CRITICALITY_COUNT; ++criticality)
+			{
+				std::copy(rows, rows + Bitmap::BLOCK_WORDS, level);
+				_src.GetCriticalityRows((CRITICALITY_LEVEL)criticality).AndBlock(block, level, levelPositions[criticality]);
+				counts[n][criticality] = Bitmap::CountBlock(level);
+				for (size_t word = 0; word < Bitmap::BLOCK_WORDS; ++word)
+				{
+					bits[word] |= level[word];
+				}
+			}
+		}
+	});
+
+	// Each block is written from the count of accepted rows of the previous ones.
+	std::vector<size_t> offsets(blocks + 1, 0);
+	for (size_t n = 0; n < blocks; ++n)
+	{
+		offsets[n + 1] = std::accumulate(counts[n].begin(), counts[n].end(), offsets[n]);
+		for (int criticality = 0; criticality < LOG_CRITICALITY_COUNT; ++criticality)
+		{
+			_criticalityCounts[criticality] += counts[n][criticality];
+		}
+	}
+	_data.resize(offsets[blocks]);
+	RunParallel(threads, [&](size_t thread)
+	{
+		for (size_t n = blocks * thread / threads; n < blocks * (thread + 1) / threads; ++n)
+		{
+			long* out = _data.data() + offsets[n];
+			Bitmap::ForEachInBlock(firstBlock + n, accepted[n].data(), [&out](uint32_t row)
+			{
+				*out++ = row;
+			});
+			std::vector<uint64_t>().swap(accepted[n]);
+		}
+	});
+
+	NotifyUpdate();
+}
+
+void FilteredLogData::BeginUpdate()
+{
+	if (_updateDepth++ == 0)
+	{
+		_updateCriteria = GetCriteria();
+		_updateReset = false;
+	}
+}
+
+void FilteredLogData::CommitUpdate()
+{
+	if (_updateDepth == 0 || --_updateDepth > 0)
+	{
+		return;
+	}
+	if (_updateReset)
+	{
+		Update();
+	}
+	else
+	{
+		Refilter(_updateCriteria);
+	}
+	std::vector<bool>().swap(_updateCriteria.shownLoggers);
+	std::vector<bool>().swap(_updateCriteria.shownFiles);
+}
+
+FilteredLogData::Criteria FilteredLogData::GetCriteria()const
+{
+	return {
+		_criticality,
+		_start.IsValid() ? LogData::ToTimestamp(_start) : INT64_MIN,
+		_end.IsValid() ? LogData::ToTimestamp(_end) : INT64_MAX,
+		_shownLoggers,
+		_shownFiles
+		};
+}
+
+void FilteredLogData::Refilter(const Criteria& previous)
+{
+	const Criteria current = GetCriteria();
+	if (current.shownLoggers.size() != previous.shownLoggers.size() || current.shownFiles.size() != previous.shownFiles.size())
+	{
+		Update();
+		return;
+	}
 
-	for (size_t n = 0; n<_src.EntryCount(); ++n)
+	// Rows of loggers, files and criticalities hidden or shown since previous criteria.
+	std::vector<const Bitmap*> hidden, shown;
+	auto compare = [&](bool before, bool after, const Bitmap& rows)
 	{
-		const Entry& entry = _src.GetEntry(n);
-		if (entry.criticality >= _criticality
-			&& (!_start.IsValid() || entry.date >= _start)
-			&& (!_end.IsValid() || entry.date <= _end)
-			&& (_shownLoggers.at(entry.logger)!=false)
-			&& (_shownFiles.at(entry.file)!=false)
-			)
+		if (before && !after)
+		{
+			hidden.push_back(&rows);
+		}
+		else if (!before && after)
 		{
-			_data.push_back(n);
-			_criticalityCounts[entry.criticality]++;
+			shown.push_back(&rows);
 		}
+	};
+	for (size_t logger = 0; logger < current.shownLoggers.size(); ++logger)
+	{
+		compare(previous.shownLoggers[logger], current.shownLoggers[logger], _src.GetLoggerRows(logger));
+	}
+	for (size_t file = 0; file < current.shownFiles.size(); ++file)
+	{
+		compare(previous.shownFiles[file], current.shownFiles[file], _src.GetFileRows(file));
+	}
+	for (int level = 0; level < LOG_CRITICALITY_COUNT; ++level)
+	{
+		compare(level >= previous.criticality, level >= current.criticality, _src.GetCriticalityRows((CRITICALITY_LEVEL)level));
+	}
+
+	size_t first, last, previousFirst, previousLast;
+	GetDateWindow(current.start, current.end, first, last);
+	GetDateWindow(previous.start, previous.end, previousFirst, previousLast);
+	if (hidden.empty() && shown.empty() && first == previousFirst && last == previousLast)
+	{
+		// Unchanged
+		return;
+	}
+
+	Bitmap rejected = Bitmap::Union(hidden);
+	Bitmap admitted = Bitmap::Union(shown);
+	// Entries newly in the time frame
+	if (previousLast <= first || last <= previousFirst || previousFirst >= previousLast)
+	{
+		admitted |= Bitmap::Range(first, last);
+	}
+	else
+	{
+		admitted |= Bitmap::Range(first, std::min(previousFirst, last));
+		admitted |= Bitmap::Range(std::max(previousLast, first), last);
+	}
+	if (rejected.Cardinality() + admitted.Cardinality() > _src.EntryCount() / 4)
+	{
+		// Too many changes, filtering again from bitmaps is faster.
+		Update();
+		return;
 	}
 
+	// Entries accepted before which are not anymore are only in rejected rows or out of the time frame.
+	// Entries not accepted before which are now are only in admitted rows.
+	Reject(rejected, first, last);
+	Admit(admitted, first, last);
 	NotifyUpdate();
 }
 
+void FilteredLogData::Reject(const Bitmap& rows, size_t first, size_t last)
+{
+	auto reject = [this](long index)
+	{
+		_criticalityCounts[_src.GetEntryCriticality(index)]--;
+	};
+
+	// Out of the time frame
+	auto begin = std::lower_bound(_data.begin(), _data.end(), (long)first);
+	auto end = std::lower_bound(begin, _data.end(), (long)last);
+	std::for_each(_data.begin(), begin, reject);
+	std::for_each(end, _data.end(), reject);
+	_data.erase(end, _data.end());
+	_data.erase(_data.begin(), begin);
+
+	// Kept entries between rejected ones are moved at once.
+	size_t kept = 0, pos = 0;
+	rows.ForEach([&](uint32_t row)
+	{
+		size_t found = std::lower_bound(_data.begin() + pos, _data.end(), (long)row) - _data.begin();
+		if (found < _data.size() && _data[found] == (long)row)
+		{
+			std::move(_data.begin() + pos, _data.begin() + found, _data.begin() + kept);
+			kept += found - pos;
+			pos = found + 1;
+			reject(row);
+		}
+	});
+	std::move(_data.begin() + pos, _data.end(), _data.begin() + kept);
+	_data.resize(kept + _data.size() - pos);
+}
+
+void FilteredLogData::Admit(const Bitmap& rows, size_t first, size_t last)
+{
+	std::vector<long> admitted;
+	rows.ForEach([&](uint32_t row)
+	{
+		if (row >= first && row < last && Accept(row))
+		{
+			admitted.push_back(row);
+			_criticalityCounts[_src.GetEntryCriticality(row)]++;
+		}
+	});
+	if (admitted.empty())
+	{
+		return;
+	}
+
+	// Merged from the end, entries before the first admitted one stay in place.
+	size_t pos = _data.size(), next = admitted.size();
+	_data.resize(_data.size() + admitted.size());
+	for (size_t at = _data.size(); next > 0; )
+	{
+		if (pos > 0 && _data[pos - 1] > admitted[next - 1])
+		{
+			_data[--at] = _data[--pos];
+		}
+		else
+		{
+			_data[--at] = admitted[--next];
+		}
+	}
+}
+
+void FilteredLogData::GetDateWindow(int64_t start, int64_t end, size_t& first, size_t& last)const
+{
+	first = _src.LowerBound(start);
+	// An inverted time frame is empty.
+	last = std::max(first, _src.UpperBound(end));
+}
+
+long FilteredLogData::FindDate(const wxDateTime& date)const
+{
+	if (_data.empty())
+	{
+		return wxNOT_FOUND;
+	}
+	int64_t timestamp = LogData::ToTimestamp(date);
+	auto it = std::lower_bound(_data.begin(), _data.end(), timestamp, [this](long index, int64_t timestamp)
+	{
+		return _src.GetEntryTimestamp(index) < timestamp;
+	});
+	size_t pos = it - _data.begin();
+	// The nearest of the entries around the date
+	if (pos == _data.size() || (pos > 0
+		&& (uint64_t)timestamp - (uint64_t)_src.GetEntryTimestamp(_data[pos - 1]) <= (uint64_t)_src.GetEntryTimestamp(_data[pos]) - (uint64_t)timestamp))
+	{
+		--pos;
+	}
+	return pos;
+}
+
 void FilteredLogData::DoSelectAllLoggers()
 {
 	_shownLoggers.clear();
@@ -342,56 +1975,55 @@ void FilteredLogData::DoSelectAllLoggers()
 
 void FilteredLogData::ClearFilter()
 {
-	_criticality = CRITICALITY_LEVEL::LOG_INFO;
-	_start = _end = wxDateTime();
-	DoSelectAllLoggers();
-	Update();
+	FilterUpdateLocker lock(*this);
+	SetCriticalityFilterLevel(CRITICALITY_LEVEL::LOG_INFO);
+	ResetStartDate();
+	ResetEndDate();
+	DisplayAllLoggers();
 }
 
 void FilteredLogData::SetCriticalityFilterLevel(CRITICALITY_LEVEL criticality)
 {
+	FilterUpdateLocker lock(*this);
 	_criticality = criticality;
-	Update();
 }
 
 void FilteredLogData::SetStartDate(const wxDateTime& date)
 {
+	FilterUpdateLocker lock(*this);
 	_start = date;
-	Update();
 }
 
 void FilteredLogData::SetEndDate(const wxDateTime& date)
 {
+	FilterUpdateLocker lock(*this);
 	_end = date;
-	Update();
 }
 
 void FilteredLogData::ResetStartDate()
 {
+	FilterUpdateLocker lock(*this);
 	_start = wxDateTime();
-	Update();
 }
 
 void FilteredLogData::ResetEndDate()
 {
+	FilterUpdateLocker lock(*this);
 	_end = wxDateTime();
-	Update();
 }
 
 void FilteredLogData::DisplayAllLoggers()
 {
-	// TODO optimize it
+	FilterUpdateLocker lock(*this);
 	_shownLoggers.clear();
 	_shownLoggers.resize(GetLogData().GetLoggerCount(), true);
-	Update();
 }
 
 void FilteredLogData::HideAllLoggers()
 {
-	// TODO optimize it
+	FilterUpdateLocker lock(*this);
 	_shownLoggers.clear();
 	_shownLoggers.resize(GetLogData().GetLoggerCount(), false);
-	Update();
 }
 
 void FilteredLogData::DisplayLogger(const wxString& logger, bool display)
@@ -404,27 +2036,25 @@ void FilteredLogData::DisplayLogger(long logger, bool display)
 	if (logger > 0 && logger < GetLogData().GetLoggerCount()
 		&& _shownLoggers.size() > logger) // TODO Review it (shall be implied)
 	{
+		FilterUpdateLocker lock(*this);
 		_shownLoggers[logger] = display;
-		Update();
 	}
 }
 
 void FilteredLogData::DisplayOnlyLogger(long logger)
 {
-	// TODO optimize it
+	FilterUpdateLocker lock(*this);
 	_shownLoggers.clear();
 	_shownLoggers.resize(GetLogData().GetLoggerCount(), false);
 	_shownLoggers[logger] = true;
-	Update();
 }
 
 void FilteredLogData::DisplayAllButLogger(long logger)
 {
-	// TODO optimize it
+	FilterUpdateLocker lock(*this);
 	_shownLoggers.clear();
 	_shownLoggers.resize(GetLogData().GetLoggerCount(), true);
 	_shownLoggers[logger] = false;
-	Update();
 }
 
 
@@ -433,8 +2063,8 @@ void FilteredLogData::ToggleLogger(long logger)
 	if (logger > 0 && logger < GetLogData().GetLoggerCount()
 		&& _shownLoggers.size() > logger) // TODO Review it (shall be implied)
 	{
+		FilterUpdateLocker lock(*this);
 		_shownLoggers[logger] = !_shownLoggers[logger];
-		Update();
 	}
 }
 
@@ -453,18 +2083,16 @@ bool FilteredLogData::IsLoggerShown(long logger)const
 
 void FilteredLogData::DisplayAllFiles()
 {
-	// TODO optimize it
+	FilterUpdateLocker lock(*this);
 	_shownFiles.clear();
 	_shownFiles.resize(GetFileData().GetFileCount(), true);
-	Update();
 }
 
 void FilteredLogData::HideAllFiles()
 {
-	// TODO optimize it
+	FilterUpdateLocker lock(*this);
 	_shownFiles.clear();
 	_shownFiles.resize(GetFileData().GetFileCount(), false);
-	Update();
 }
 
 void FilteredLogData::DisplayFile(const wxString& file, bool display)
@@ -479,8 +2107,8 @@ void FilteredLogData::DisplayFile(uint16_t file, bool display)
 	if (file < GetFileData().GetFileCount()
 		&& _shownFiles.size() > file) // TODO Review it (shall be implied)
 	{
+		FilterUpdateLocker lock(*this);
 		_shownFiles[file] = display;
-		Update();
 	}
 
 }
@@ -490,8 +2118,8 @@ void FilteredLogData::ToggleFile(uint16_t file)
 	if (file < GetFileData().GetFileCount()
 		&& _shownFiles.size() > file) // TODO Review it (shall be implied)
 	{
+		FilterUpdateLocker lock(*this);
 		_shownFiles[file] = !_shownFiles[file];
-		Update();
 	}
 }
 
@@ -513,32 +2141,168 @@ bool FilteredLogData::IsFileShown(uint16_t file)const
 
 wxStringCache::wxStringCache()
 {
-	push_back("");
+	Rehash(16);
+	Insert("", Hash(wxString()));
 }
 
-long wxStringCache::Find(const wxString& str)const
+size_t wxStringCache::Hash(const wxString& str)
+{
+	uint64_t hash = 14695981039346656037ULL;	// FNV-1a on code points
+	for (wxString::const_iterator it = str.begin(); it != str.end(); ++it)
+	{
+		wxUniChar c = *it;
+		hash = (hash ^ c.GetValue()) * 1099511628211ULL;
+	}
+	return (size_t)hash;
+}
+
+size_t wxStringCache::Hash(StrView str)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const char* p = str.begin; p < str.end; ++p)
+	{
+		hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+	}
+	return (size_t)hash;
+}
+
+template<typename Equals>
+long wxStringCache::Lookup(size_t hash, Equals equals)const
 {
-	for (long n = 0; n<size(); ++n)
+	size_t mask = _slots.size() - 1;
+	for (size_t slot = hash & mask; _slots[slot] != wxNOT_FOUND; slot = (slot + 1) & mask)
 	{
-		if (at(n) == str)
+		long id = _slots[slot];
+		if (_hashes[id] == hash && equals(at(id)))
 		{
-			return n;
+			return id;
 		}
 	}
 	return wxNOT_FOUND;
 }
 
+long wxStringCache::Insert(wxString str, size_t hash)
+{
+	long id = size();
+	push_back(std::move(str));
+	_hashes.push_back(hash);
+	if (size() * 2 > _slots.size())
+	{
+		Rehash(_slots.size() * 2);
+	}
+	else
+	{
+		size_t mask = _slots.size() - 1;
+		size_t slot = hash & mask;
+		while (_slots[slot] != wxNOT_FOUND)
+		{
+			slot = (slot + 1) & mask;
+		}
+		_slots[slot] = id;
+	}
+	return id;
+}
+
+void wxStringCache::Rehash(size_t capacity)
+{
+	_slots.assign(capacity, wxNOT_FOUND);
+	size_t mask = capacity - 1;
+	for (long id = 0; id < (long)size(); ++id)
+	{
+		size_t slot = _hashes[id] & mask;
+		while (_slots[slot] != wxNOT_FOUND)
+		{
+			slot = (slot + 1) & mask;
+		}
+		_slots[slot] = id;
+	}
+}
+
+bool wxStringCache::Sort(std::vector<long>& reindex)
+{
+	reindex.clear();
+	const_iterator unsorted = std::is_sorted_until(begin(), end());
+	if (unsorted == end())
+	{
+		return false;
+	}
+
+	// Sort a permutation of ids rather than the strings themselves.
+	auto less = [&](long a, long b)->bool
+	{
+		return at(a) < at(b);
+	};
+	std::vector<long> order(size());
+	std::iota(order.begin(), order.end(), 0);
+	auto middle = order.begin() + (unsorted - begin());
+	std::sort(middle, order.end(), less);
+	std::inplace_merge(order.begin(), middle, order.end(), less);
+
+	reindex.resize(size());
+	std::vector<wxString> strings;
+	std::vector<size_t> hashes;
+	strings.reserve(size());
+	hashes.reserve(size());
+	for (long id = 0; id < (long)order.size(); ++id)
+	{
+		reindex[order[id]] = id;
+		strings.push_back(std::move(at(order[id])));
+		hashes.push_back(_hashes[order[id]]);
+	}
+	std::vector<wxString>::swap(strings);
+	std::swap(_hashes, hashes);
+	Rehash(_slots.size());
+	return true;
+}
+
+long wxStringCache::Find(const wxString& str)const
+{
+	return Lookup(Hash(str), [&](const wxString& other) { return other == str; });
+}
+
 long wxStringCache::Get(const wxString& str)
 {
-	for (long n = 0; n<size(); ++n)
+	size_t hash = Hash(str);
+	long id = Lookup(hash, [&](const wxString& other) { return other == str; });
+	return id != wxNOT_FOUND ? id : Insert(str, hash);
+}
+
+// Compare an ASCII view with a string, without converting it.
+static inline bool AsciiEquals(StrView view, const wxString& str)
+{
+	if (view.size() != str.length())
 	{
-		if (at(n) == str)
+		return false;
+	}
+	wxString::const_iterator it = str.begin();
+	for (const char* p = view.begin; p < view.end; ++p, ++it)
+	{
+		if (*it != *p)
 		{
-			return n;
+			return false;
 		}
 	}
-	push_back(str);
-	return size() - 1;
+	return true;
+}
+
+long wxStringCache::Find(StrView str)const
+{
+	if (!str.IsAscii())
+	{
+		return Find(str.ToString());
+	}
+	return Lookup(Hash(str), [&](const wxString& other) { return AsciiEquals(str, other); });
+}
+
+long wxStringCache::Get(StrView str)
+{
+	if (!str.IsAscii())
+	{
+		return Get(str.ToString());
+	}
+	size_t hash = Hash(str);
+	long id = Lookup(hash, [&](const wxString& other) { return AsciiEquals(str, other); });
+	return id != wxNOT_FOUND ? id : Insert(str.ToString(), hash);
 }
 
 const wxString& wxStringCache::GetString(long id)const
@@ -22,11 +22,17 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
 #include <vector>
 #include <set>
+#include <unordered_map>
 
 #include <wx/arrstr.h>
 
+#include "bitmap.hpp"
+
 class LogData;
 
 inline wxString str2wx(const std::string& str)
@@ -40,15 +46,92 @@ inline std::string wx2str(const wxString str)
 }
 
 
-class wxStringCache : public std::vector<wxString>
+/**
+ * Non-owning view over a range of (UTF-8) bytes.
+ */
+struct StrView
+{
+	const char* begin;
+	const char* end;
+
+	StrView() : begin(nullptr), end(nullptr) {}
+	StrView(const char* begin, const char* end) : begin(begin), end(end) {}
+
+	size_t size()const { return end - begin; }
+	bool empty()const { return begin == end; }
+
+	bool IsAscii()const;
+
+	StrView Trim()const { return TrimLeft().TrimRight(); }
+	StrView TrimLeft()const;
+	StrView TrimRight()const;
+
+	/** Convert from UTF-8, falling back to latin-1 for invalid sequences. */
+	wxString ToString()const;
+
+	static bool IsSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+};
+
+inline StrView StrView::TrimLeft()const
+{
+	const char* b = begin;
+	while (b < end && IsSpace(*b))
+		++b;
+	return StrView(b, end);
+}
+
+inline StrView StrView::TrimRight()const
+{
+	const char* e = end;
+	while (e > begin && IsSpace(e[-1]))
+		--e;
+	return StrView(begin, e);
+}
+
+
+/**
+ * Dictionary of strings, each one identified by a dense id.
+ * Strings are indexed by a hash computed on code points, so that ASCII views
+ * are found without being converted.
+ */
+class wxStringCache : protected std::vector<wxString>
 {
 public:
+	typedef std::vector<wxString>::const_iterator const_iterator;
+
 	wxStringCache();
 
 	long Find(const wxString& str)const;
+	long Find(StrView str)const;
 
 	long Get(const wxString& str);
+	long Get(StrView str);
 	const wxString& GetString(long id)const;
+
+	/** Sort strings. Strings inserted since the previous sort are sorted then
+	 * merged with the already sorted ones. Fill reindex with the new id of each
+	 * former id, return false (reindex left empty) when the order did not change. */
+	bool Sort(std::vector<long>& reindex);
+	const std::vector<wxString>& GetStrings()const { return *this; }
+
+	using std::vector<wxString>::size;
+	using std::vector<wxString>::empty;
+	const_iterator begin()const { return std::vector<wxString>::begin(); }
+	const_iterator end()const { return std::vector<wxString>::end(); }
+	const wxString& operator[](size_t id)const { return std::vector<wxString>::operator[](id); }
+
+	static size_t Hash(const wxString& str);
+	/** Hash of an ASCII view, same as the one of the equivalent string. */
+	static size_t Hash(StrView str);
+
+protected:
+	std::vector<size_t> _hashes;	// Hash of each string
+	std::vector<long> _slots;		// Open addressing table of ids, wxNOT_FOUND when free
+
+	template<typename Equals>
+	long Lookup(size_t hash, Equals equals)const;
+	long Insert(wxString str, size_t hash);
+	void Rehash(size_t capacity);
 };
 
 
@@ -66,7 +149,13 @@ enum CRITICALITY_LEVEL
 	LOG_CRITICALITY_COUNT
 };
 
+/** Count of entries by criticality. */
+typedef std::array<size_t, LOG_CRITICALITY_COUNT> CriticalityCounts;
+
 
+/**
+ * Log entry, as parsed or as rebuilt from the columns of a LogData.
+ */
 struct Entry
 {
 	wxDateTime date;
@@ -80,6 +169,129 @@ struct Entry
 };
 
 
+/** Reference of a text in a TextArena, 0 is the empty text. */
+typedef uint64_t TextRef;
+
+/**
+ * Append-only storage of UTF-8 texts, in large pages released all together.
+ * References are made of the page and the offset of a text, prefixed by its length.
+ * Full pages can be compressed, they are unpacked on demand in a cache shared by all arenas.
+ */
+class TextArena
+{
+public:
+	static const size_t PAGE_SIZE = 1024 * 1024;
+
+	TextRef Add(const char* text, size_t size);
+	TextRef Add(StrView text) { return Add(text.begin, text.size()); }
+	TextRef Add(const wxString& text);
+	/** Append to a referenced text, return the reference of the result. */
+	TextRef Append(TextRef ref, StrView text);
+
+	/** View of a text, valid until the arena is modified.
+	 * Texts of compressed pages are copied in buffer. */
+	StrView Get(TextRef ref, std::string& buffer)const;
+	/** Convert a text, only when it have to be displayed. */
+	wxString GetString(TextRef ref)const { std::string buffer; return Get(ref, buffer).ToString(); }
+
+	/** Move the pages of another arena after these ones.
+	 * Return the value to add to (non-empty) references to its texts. */
+	TextRef Adopt(TextArena&& other);
+
+	/** Compress full pages not compressed yet, texts are appended to the others. */
+	void Compress();
+	static bool IsCompressionAvailable();
+
+	/** Release all pages. */
+	void Clear();
+
+protected:
+	struct Page
+	{
+		std::vector<char> text;
+		// Compressed text, the page text is then released.
+		std::vector<char> packed;
+		size_t size = 0;
+		// Key of the page in the cache of unpacked ones, 0 when not compressed.
+		uint64_t id = 0;
+
+		bool IsPacked()const { return id != 0; }
+	};
+	std::vector<Page> _pages;
+	// Page receiving the texts fitting in a common page
+	size_t _current = 0;
+};
+
+
+/**
+ * Index of the distinct texts of an arena, identical texts being stored once.
+ * Each text counts the references to it.
+ */
+class TextTable
+{
+public:
+	/** Reference of a text, added to the arena unless already there, its count being increased. */
+	TextRef Intern(TextArena& arena, StrView text, size_t count = 1);
+	/** Reference of a text continued, the former one being released. */
+	TextRef Append(TextArena& arena, TextRef ref, StrView text);
+	/** Decrease the count of a text, it stays in the arena. */
+	void Release(TextRef ref, size_t count = 1);
+
+	size_t GetCount(TextRef ref)const;
+
+	/** Referenced texts with their counts. */
+	typedef std::unordered_map<TextRef, size_t>::const_iterator const_iterator;
+	const_iterator begin()const { return _counts.begin(); }
+	const_iterator end()const { return _counts.end(); }
+
+protected:
+	std::unordered_multimap<size_t, TextRef> _refs;		// By hash
+	std::unordered_map<TextRef, size_t> _counts;
+};
+
+
+/**
+ * Entry of a LogShard, its texts are stored in the shard text arenas.
+ */
+struct ShardEntry
+{
+	wxDateTime date;
+	uint16_t file;
+	CRITICALITY_LEVEL criticality;
+	long thread;
+	long logger;
+	long source;
+	TextRef message;
+	TextRef extra;
+};
+
+
+/**
+ * Log entries parsed apart from LogData, typically by a worker thread.
+ * Shards have their own dictionaries, entry ids refer to them until the
+ * shard is appended to a LogData.
+ */
+struct LogShard
+{
+	uint16_t file = 0;
+	wxStringCache threads, loggers, sources;
+	std::vector<ShardEntry> entries;
+	TextArena texts;
+	/** Extras apart, only distinct ones not already known are copied when appended. */
+	TextArena extras;
+	TextTable extraTable;
+
+	/** Extra lines (UTF-8) found before the first entry, they belong to the last entry of the previous shard.
+	 * When appended, they continue the last entry of the file already in the log data. */
+	std::string leadingExtra;
+
+	/** Parsed from the unterminated last line of a file, replaced by the next shard appended from the file. */
+	bool tail = false;
+
+	void AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, StrView thread, StrView logger, StrView source, StrView message);
+};
+
+
 struct FileDescriptor
 {
 	FileDescriptor():id(0), path() {}
@@ -102,9 +314,26 @@ struct FileDescriptor
 		FILE_REMOVED	// The file will be removed
 	} status = FILE_NEW;
 
-	size_t entryCount;
-	std::array<size_t, LOG_CRITICALITY_COUNT> criticalityCounts;
+	size_t entryCount = 0;
+	CriticalityCounts criticalityCounts{};
 
+	/** Size of the content already parsed, UNKNOWN_OFFSET until the file is completely loaded. */
+	uint64_t offset = UNKNOWN_OFFSET;
+	static const uint64_t UNKNOWN_OFFSET = (uint64_t)-1;
+	/** Loading has been cancelled before the end of the file, the next load resumes it from offset. */
+	bool partial = false;
+
+	// State of the file when its content has been parsed up to offset.
+	uint64_t size = 0;
+	wxDateTime modified;
+	uint64_t fingerprint = 0;
+
+	/** Remember the current state of the file, after parsing it up to offset. */
+	void Stamp();
+	/** Is the file as it was when stamped ? */
+	bool IsUnchanged()const;
+	/** Is the parsed content still at the beginning of the file ? (when only appended to) */
+	bool IsPrefixUnchanged()const;
 
 	static wxString StatusToString(FILE_DESC_STATUS status);
 };
@@ -150,9 +379,17 @@ public:
 	iterator end() {return _fileDescriptors.end();}
 	const_iterator end()const {return _fileDescriptors.end();}
 	
+	/** Remove files, remaining ones are renumbered to keep ids matching positions.
+	 * Return the new id of each former one, wxNOT_FOUND for removed ones. */
 	template<typename Pred>
-	void RemoveFileIf(Pred pred) {
+	std::vector<long> RemoveFileIf(Pred pred) {
+		std::vector<long> ids(_fileDescriptors.size(), wxNOT_FOUND);
 		_fileDescriptors.erase(std::remove_if(_fileDescriptors.begin(), _fileDescriptors.end(), pred), _fileDescriptors.end());
+		for (size_t n = 0; n < _fileDescriptors.size(); ++n) {
+			ids[_fileDescriptors[n].id] = n;
+			_fileDescriptors[n].id = n;
+		}
+		return ids;
 	}
 
 	// @name Stats
@@ -183,32 +420,126 @@ public:
 
 
 
+/**
+ * Changes of a LogData between two synchronizations.
+ */
+struct LogChanges
+{
+	/** Count of entries removed, previous entries have to be considered as all changed. */
+	size_t removed = 0;
+	/** Too many entries have been inserted to report their positions, all have to be considered as changed. */
+	bool reset = false;
+	/** Positions of new entries, in increasing order. Other entries kept their relative order. */
+	std::vector<size_t> inserted;
+	/** Positions of entries changed in place (extended extra), in increasing order. */
+	std::vector<size_t> updated;
+	/** New ids of labels from former ones, when they have been sorted again (empty otherwise). */
+	std::vector<long> threads, loggers, sources;
+	/** New ids of files from former ones, wxNOT_FOUND for removed ones (empty when unchanged). */
+	std::vector<long> files;
+
+	bool IsReset()const { return removed > 0 || reset; }
+	bool IsEmpty()const { return !IsReset() && inserted.empty() && updated.empty() && threads.empty() && loggers.empty() && sources.empty() && files.empty(); }
+};
+
+
 class LogData
 {
 public:
 	struct Listener
 	{
-		virtual void Updated(LogData& data) = 0;
+		/** Called when synchronizing the log data, if something changed. */
+		virtual void Changed(LogData& data, const LogChanges& changes) = 0;
 	};
 
-	typedef std::vector<Entry> FileVector;
-	typedef std::vector<Entry>::iterator iterator;
-	typedef std::vector<Entry>::const_iterator const_iterator;
+	/** Timestamp of entries without date. */
+	static const int64_t INVALID_DATE = INT64_MIN;
+
+	static int64_t ToTimestamp(const wxDateTime& date) { return date.IsValid() ? date.GetValue().GetValue() : INVALID_DATE; }
+	static wxDateTime ToDate(int64_t timestamp) { return timestamp != INVALID_DATE ? wxDateTime(wxLongLong(timestamp)) : wxDateTime(); }
 
 protected:
 	FileData& _fileData;
 
 	wxStringCache _threads, _loggers, _sources;
 
-	std::vector<Entry> _entries;
+	/** Entries of a file, stored by columns in the order they have been appended. */
+	struct FileSegment
+	{
+		std::vector<int64_t> dates;		// Milliseconds since epoch
+		std::vector<uint8_t> criticalities;
+		std::vector<uint32_t> threadIds, loggerIds, sourceIds;
+		std::vector<TextRef> messages, extras;
+		TextArena texts;
+		// Extras in texts, stack traces are often repeated.
+		TextTable extraTable;
+		/** Entries before are in the index. */
+		size_t synchronized = 0;
+		/** Entries and extra of the last one before the unterminated last line, when it has been parsed. */
+		bool tail = false;
+		size_t tailSize = 0;
+		TextRef tailExtra = 0;
+
+		size_t size()const { return dates.size(); }
+	};
+	std::vector<FileSegment> _segments;		// By file id
+
+	// Synchronized entries of all files, by date: file id in the upper bits, index in its segment below.
+	std::vector<uint64_t> _index;
+	static const int FILE_SHIFT = 48;
+	static const uint64_t ENTRY_MASK = ((uint64_t)1 << FILE_SHIFT) - 1;
+
+	static uint64_t MakeRef(uint16_t file, size_t entry) { return ((uint64_t)file << FILE_SHIFT) | entry; }
+	int64_t GetDate(uint64_t ref)const { return _segments[ref >> FILE_SHIFT].dates[ref & ENTRY_MASK]; }
 
-	std::array<size_t, LOG_CRITICALITY_COUNT> _criticalityCounts;
+	template<typename T>
+	const T& Column(std::vector<T> FileSegment::*column, size_t index)const
+	{
+		uint64_t ref = _index[index];
+		return (_segments[ref >> FILE_SHIFT].*column)[ref & ENTRY_MASK];
+	}
+	wxString Text(std::vector<TextRef> FileSegment::*column, size_t index)const
+	{
+		const FileSegment& segment = _segments[_index[index] >> FILE_SHIFT];
+		return segment.texts.GetString((segment.*column)[_index[index] & ENTRY_MASK]);
+	}
 
-	std::vector<long> _loggersEntryCount;
-	std::vector<std::array<size_t, LOG_CRITICALITY_COUNT>> _criticalityLoggerCounts;
+	FileSegment& GetSegment(uint16_t file);
+	/** Row of a synchronized entry in the index. */
+	size_t FindRow(uint64_t ref)const;
+	/** Remove what has been parsed from the unterminated last line of a file, if any. */
+	void RemoveTail(uint16_t file);
+
+	// Statistics, by criticality for all entries and for each label.
+	CriticalityCounts _criticalityCounts{};
+	std::vector<CriticalityCounts> _criticalityLoggerCounts, _criticalityThreadCounts, _criticalitySourceCounts;
+
+	// Rows of the index by criticality and by label, for filtering.
+	std::array<Bitmap, LOG_CRITICALITY_COUNT> _criticalityRows;
+	std::vector<Bitmap> _threadRows, _loggerRows, _fileRows;
+	/** Rows before are in the bitmaps. */
+	size_t _indexedRows = 0;
+	/** Add rows from the first one not in the bitmaps. */
+	void UpdateRows();
+	/** Remove sorted rows from the bitmaps, following ones moving down as in the index. */
+	void EraseRows(const std::vector<uint32_t>& rows);
+	static const Bitmap& Rows(const std::vector<Bitmap>& rows, size_t id);
+
+	LogChanges _changes;
+	/** Synchronized entries changed since the previous synchronization, by reference. */
+	std::vector<uint64_t> _updated;
+	/** Report positions of changed entries, once new entries are sorted. */
+	void ReportUpdates();
+
+	// Read by loading threads
+	std::atomic<bool> _compressTexts{ false };
 
 	std::set<Listener*> _listeners;
-	void NotifyUpdate();
+	void NotifyChanges();
+
+	/** Add (increment 1) or remove (-1) entries of a file from statistics. */
+	void UpdateStatistics(uint16_t file, size_t first, size_t last, long increment);
+	static size_t Sum(const CriticalityCounts& counts) { return std::accumulate(counts.begin(), counts.end(), (size_t)0); }
 
 public:
 	LogData(FileData& fileData);
@@ -218,31 +549,57 @@ public:
 
 	void Clear();
 	void AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, wxString thread, wxString logger, wxString source, wxString message);
-	void AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, long thread, long logger, long source, const wxString& message);
-
-	template<typename Pred>
-	void RemoveLogIf(Pred pred) {
-		_entries.erase(std::remove_if(_entries.begin(), _entries.end(), pred), _entries.end());
-	}
-
+	void AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, StrView thread, StrView logger, StrView source, StrView message);
+	void AddLog(const wxDateTime& date, uint16_t file, CRITICALITY_LEVEL criticality, long thread, long logger, long source, StrView message);
+	void Append(LogShard&& shard);
+	/** Append lines newly parsed from the end of a file and synchronize. */
+	void Extend(uint16_t file, LogShard&& shard);
+
+	/** Remove the entries of files, releasing their memory. */
+	void RemoveFileLogs(const std::vector<uint16_t>& files);
+	/** Follow files renumbering, as returned by FileData::RemoveFileIf.
+	 * Entries of removed files have to be removed before. */
+	void RenumberFiles(const std::vector<long>& ids);
+
+	/** Keep texts of new entries compressed, and compress those already there when enabling it.
+	 * Compressed texts are unpacked when displayed. */
+	void SetTextCompression(bool compress);
+	bool IsTextCompressed()const { return _compressTexts; }
+
+	/** Sort and index the changes since the previous synchronization, then notify them. */
 	void Synchronize();
 
 	void SortLogsByDate();
 	void SortAndReindexColumns();
+	/** Count all entries again, statistics are otherwise kept up to date when adding and removing entries. */
 	void UpdateStatistics();
 
-	size_t EntryCount()const { return _entries.size(); }
-
-	Entry& GetEntry(size_t index) { return _entries[index]; }
-	const Entry& GetEntry(size_t index) const { return _entries[index]; }
+	/** Count of synchronized entries. */
+	size_t EntryCount()const { return _index.size(); }
 
-	Entry& GetLastEntry() { return _entries.back(); }
-	const Entry& GetLastEntry() const { return _entries.back(); }
+	/** Copy of an entry, prefer column accessors to scan entries. */
+	Entry GetEntry(size_t index) const;
 
-	iterator begin() {return _entries.begin();}
-	const_iterator begin()const {return _entries.begin();}
-	iterator end() {return _entries.end();}
-	const_iterator end()const {return _entries.end();}
+	// @name Column accessors
+	// @{
+	int64_t GetEntryTimestamp(size_t index)const { return Column(&FileSegment::dates, index); }
+	wxDateTime GetEntryDate(size_t index)const { return ToDate(GetEntryTimestamp(index)); }
+	CRITICALITY_LEVEL GetEntryCriticality(size_t index)const { return (CRITICALITY_LEVEL)Column(&FileSegment::criticalities, index); }
+	uint16_t GetEntryFile(size_t index)const { return _index[index] >> FILE_SHIFT; }
+	long GetEntryThread(size_t index)const { return Column(&FileSegment::threadIds, index); }
+	long GetEntryLogger(size_t index)const { return Column(&FileSegment::loggerIds, index); }
+	long GetEntrySource(size_t index)const { return Column(&FileSegment::sourceIds, index); }
+	wxString GetEntryMessage(size_t index)const { return Text(&FileSegment::messages, index); }
+	wxString GetEntryExtra(size_t index)const { return Text(&FileSegment::extras, index); }
+	bool HasEntryExtra(size_t index)const { return Column(&FileSegment::extras, index) != 0; }
+	/** Index of the first entry dated at or after a timestamp, entries being sorted by date. */
+	size_t LowerBound(int64_t timestamp)const;
+	/** Index of the first entry dated after a timestamp. */
+	size_t UpperBound(int64_t timestamp)const;
+
+	/** Count of entries of the same file sharing the extra of an entry. */
+	size_t GetEntryExtraCount(size_t index)const { return _segments[GetEntryFile(index)].extraTable.GetCount(Column(&FileSegment::extras, index)); }
+	// @}
 
 
 	size_t GetCriticalityCount(CRITICALITY_LEVEL level)const { return _criticalityCounts[level]; }
@@ -265,8 +622,20 @@ public:
 	long FindLogger(const wxString& name) const { return _loggers.Find(name); }
 	long FindSource(const wxString& name) const { return _sources.Find(name); }
 
-	long GetLoggerEntryCount(long logger) const {return _loggersEntryCount[logger]; }
+	long GetLoggerEntryCount(long logger) const {return Sum(_criticalityLoggerCounts[logger]); }
 	long GetLoggerCriticalityEntryCount(long logger, CRITICALITY_LEVEL criticality) const {return _criticalityLoggerCounts[logger][criticality]; }
+	long GetThreadEntryCount(long thread) const {return Sum(_criticalityThreadCounts[thread]); }
+	long GetThreadCriticalityEntryCount(long thread, CRITICALITY_LEVEL criticality) const {return _criticalityThreadCounts[thread][criticality]; }
+	long GetSourceEntryCount(long source) const {return Sum(_criticalitySourceCounts[source]); }
+	long GetSourceCriticalityEntryCount(long source, CRITICALITY_LEVEL criticality) const {return _criticalitySourceCounts[source][criticality]; }
+
+	// @name Rows of synchronized entries
+	// @{
+	const Bitmap& GetCriticalityRows(CRITICALITY_LEVEL criticality)const { return _criticalityRows[criticality]; }
+	const Bitmap& GetThreadRows(long thread)const { return Rows(_threadRows, thread); }
+	const Bitmap& GetLoggerRows(long logger)const { return Rows(_loggerRows, logger); }
+	const Bitmap& GetFileRows(uint16_t file)const { return Rows(_fileRows, file); }
+	// @}
 
 
 	// @name Listener management
@@ -283,25 +652,56 @@ public:
 	struct Listener
 	{
 		virtual void Updated(FilteredLogData& data) = 0;
+		/** Entries have been appended from the specified index, previous ones are unchanged. */
+		virtual void Appended(FilteredLogData& data, size_t first) { Updated(data); }
+		/** Entries at the specified indexes, in increasing order, have changed in place. */
+		virtual void Modified(FilteredLogData& data, const std::vector<size_t>& rows) {}
 	};
 
 protected:
 	LogData & _src;
 
 	std::vector<long> _data;
-	std::array<size_t, LOG_CRITICALITY_COUNT> _criticalityCounts;
+	CriticalityCounts _criticalityCounts;
 
 	std::vector<bool> _shownLoggers, _shownFiles;
 
 	CRITICALITY_LEVEL _criticality = CRITICALITY_LEVEL::LOG_INFO;
 	wxDateTime _start, _end;
 
-	virtual void Updated(LogData & data) override;
+	virtual void Changed(LogData & data, const LogChanges& changes) override;
+
+	/** Criteria of the filter, kept before changing them to refilter incrementally. */
+	struct Criteria
+	{
+		CRITICALITY_LEVEL criticality;
+		int64_t start, end;		// Full range when not set
+		std::vector<bool> shownLoggers, shownFiles;
+	};
+	Criteria GetCriteria()const;
+
+	// Batched criteria changes
+	size_t _updateDepth = 0;
+	Criteria _updateCriteria;
+	/** Log data changed during the batch, entries are filtered again from scratch. */
+	bool _updateReset = false;
 
 	void Update();
+	/** Update filtered entries from those accepted with previous criteria,
+	 * only testing entries which may have changed. */
+	void Refilter(const Criteria& previous);
+	/** Remove entries outside [first, last) or in rows. */
+	void Reject(const Bitmap& rows, size_t first, size_t last);
+	/** Add entries of rows within [first, last) if accepted, none of them being already there. */
+	void Admit(const Bitmap& rows, size_t first, size_t last);
+	/** Range [first, last) of entries dated from start to end. */
+	void GetDateWindow(int64_t start, int64_t end, size_t& first, size_t& last)const;
+	bool Accept(size_t index)const;
 
 	std::set<Listener*> _listeners;
 	void NotifyUpdate();
+	void NotifyAppend(size_t first);
+	void NotifyModify(const std::vector<size_t>& rows);
 
 private:
 	void DoSelectAllLoggers();
@@ -318,8 +718,18 @@ public:
 
 	size_t EntryCount()const { return _data.size(); }
 
-	Entry& GetEntry(size_t index) { return GetLogData().GetEntry(_data[index]); }
-	const Entry& GetEntry(size_t index) const { return GetLogData().GetEntry(_data[index]); }
+	/** Begin a batch of criteria changes, entries are filtered once when the outermost batch is committed.
+	 * Prefer FilterUpdateLocker. */
+	void BeginUpdate();
+	void CommitUpdate();
+	bool IsUpdating()const { return _updateDepth > 0; }
+
+	Entry GetEntry(size_t index) const { return GetLogData().GetEntry(_data[index]); }
+	wxDateTime GetEntryDate(size_t index) const { return GetLogData().GetEntryDate(_data[index]); }
+	/** Index in the log data of a filtered entry. */
+	size_t GetEntryIndex(size_t index) const { return _data[index]; }
+	/** Filtered entry dated the nearest to a date, wxNOT_FOUND if none. */
+	long FindDate(const wxDateTime& date)const;
 
 	size_t GetCriticalityCount(CRITICALITY_LEVEL level)const { return _criticalityCounts[level]; }
 	wxDateTime GetBeginDate()const;
@@ -357,6 +767,16 @@ public:
 	void RemListener(Listener* listener) { _listeners.erase(listener); }
 };
 
+/** Batch the filter criteria changes of a scope. */
+class FilterUpdateLocker
+{
+public:
+	FilterUpdateLocker(FilteredLogData& data) : _data(data) { _data.BeginUpdate(); }
+	~FilterUpdateLocker() { _data.CommitUpdate(); }
+
+protected:
+	FilteredLogData& _data;
+};
 
 
 
@@ -0,0 +1,328 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+* follower.cpp
+* Copyright (C) 2019 Emilien Kia <Emilien.Kia+dev@gmail.com>
+*
+* logviewer is free software: you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the
+* Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* logviewer is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <wx/wx.h>
+
+#include <wx/filename.h>
+#include <wx/fswatcher.h>
+
+#include <set>
+
+#include "follower.hpp"
+#include "parser.hpp"
+
+#if defined(__WINDOWS__)
+#include <wx/msw/wrapwin.h>
+#include <fcntl.h>
+#include <io.h>
+#elif defined(__UNIX__)
+#include <sys/stat.h>
+#endif
+
+
+//
+// Platform helpers
+//
+
+#if defined(__WINDOWS__)
+
+// Open a file without preventing it to be renamed or removed by its writer.
+static bool OpenShared(wxFFile& file, const wxString& path)
+{
+	HANDLE handle = ::CreateFileW(path.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	int fd = ::_open_osfhandle((intptr_t)handle, _O_RDONLY | _O_BINARY);
+	if (fd == -1)
+	{
+		::CloseHandle(handle);
+		return false;
+	}
+	FILE* fp = ::_fdopen(fd, "rb");
+	if (fp == nullptr)
+	{
+		::_close(fd);
+		return false;
+	}
+	file.Attach(fp, path);
+	return true;
+}
+
+// Is the path still designating the opened file ? (true when it cannot be told)
+static bool IsSameFile(wxFFile& file, const wxString& path)
+{
+	BY_HANDLE_FILE_INFORMATION opened, current;
+	HANDLE handle = (HANDLE)::_get_osfhandle(::_fileno(file.fp()));
+	if (!::GetFileInformationByHandle(handle, &opened))
+	{
+		return true;
+	}
+	HANDLE other = ::CreateFileW(path.wc_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (other == INVALID_HANDLE_VALUE)
+	{
+		return true;
+	}
+	bool res = !::GetFileInformationByHandle(other, &current)
+		|| (opened.dwVolumeSerialNumber == current.dwVolumeSerialNumber
+			&& opened.nFileIndexHigh == current.nFileIndexHigh
+			&& opened.nFileIndexLow == current.nFileIndexLow);
+	::CloseHandle(other);
+	return res;
+}
+
+#else // Not windows
+
+static bool OpenShared(wxFFile& file, const wxString& path)
+{
+	return file.Open(path, "rb");
+}
+
+static bool IsSameFile(wxFFile& file, const wxString& path)
+{
+#if defined(__UNIX__)
+	struct stat opened, current;
+	if (::fstat(::fileno(file.fp()), &opened) != 0 || ::stat(path.fn_str(), &current) != 0)
+	{
+		// Removed or renamed, but not yet replaced.
+		return true;
+	}
+	return opened.st_dev == current.st_dev && opened.st_ino == current.st_ino;
+#else
+	return true;
+#endif
+}
+
+#endif
+
+
+//
+// LogFollower
+//
+
+LogFollower::LogFollower(LogData& data):
+_data(data),
+_checkTimer(this),
+_pollTimer(this)
+{
+	Bind(wxEVT_TIMER, &LogFollower::OnTimer, this);
+}
+
+LogFollower::~LogFollower()
+{
+	Stop();
+	delete _watcher;
+}
+
+void LogFollower::Start()
+{
+	_following = true;
+	Refresh();
+}
+
+void LogFollower::Stop()
+{
+	_following = false;
+	Clear();
+}
+
+void LogFollower::Clear()
+{
+	_checkTimer.Stop();
+	_pollTimer.Stop();
+#if wxUSE_FSWATCHER
+	if (_watcher != nullptr)
+	{
+		_watcher->RemoveAll();
+	}
+#endif // wxUSE_FSWATCHER
+
+	// Stamp files only when following ends, fingerprinting is too costly to be done on each check.
+	for (auto& followed : _followed)
+	{
+		if (followed->stamped)
+		{
+			continue;
+		}
+		for (FileDescriptor& fd : _data.GetFileData())
+		{
+			if (fd.path == followed->path)
+			{
+				fd.Stamp();
+			}
+		}
+	}
+	_followed.clear();
+}
+
+void LogFollower::Refresh()
+{
+	Clear();
+	if (!_following)
+	{
+		return;
+	}
+
+	std::set<wxString> dirs;
+	for (const FileDescriptor& fd : _data.GetFileData())
+	{
+		if (fd.status != FileDescriptor::FILE_LOADED || fd.partial || fd.offset == FileDescriptor::UNKNOWN_OFFSET)
+		{
+			// Not (completely) loaded yet
+			continue;
+		}
+		std::unique_ptr<FollowedFile> followed(new FollowedFile);
+		if (!OpenShared(followed->file, fd.path))
+		{
+			continue;
+		}
+		followed->id = fd.id;
+		followed->path = fd.path;
+		followed->offset = fd.offset;
+		_followed.push_back(std::move(followed));
+
+		wxFileName name(fd.path);
+		name.MakeAbsolute();
+		dirs.insert(name.GetPath());
+	}
+	if (_followed.empty())
+	{
+		return;
+	}
+
+#if wxUSE_FSWATCHER
+	if (_watcher == nullptr)
+	{
+		_watcher = new wxFileSystemWatcher();
+		_watcher->SetOwner(this);
+		Bind(wxEVT_FSWATCHER, &LogFollower::OnFileSystemEvent, this);
+	}
+	for (const wxString& dir : dirs)
+	{
+		_watcher->Add(wxFileName::DirName(dir), wxFSW_EVENT_CREATE | wxFSW_EVENT_DELETE | wxFSW_EVENT_RENAME | wxFSW_EVENT_MODIFY);
+	}
+#endif // wxUSE_FSWATCHER
+
+	_pollTimer.Start(POLL_PERIOD);
+
+	// Catch up with what have been written since loading.
+	Check();
+}
+
+void LogFollower::Check()
+{
+	for (auto& followed : _followed)
+	{
+		Check(*followed);
+	}
+}
+
+void LogFollower::Check(FollowedFile& followed)
+{
+	wxFileOffset length = followed.file.Length();
+	if (length >= 0 && (uint64_t)length < followed.offset)
+	{
+		// Truncated (copy-truncate rotation): forget previous content.
+		_data.RemoveFileLogs({ followed.id });
+		_data.Synchronize();
+		followed.offset = 0;
+	}
+
+	while (ReadAppended(followed));
+
+	if (!IsSameFile(followed.file, followed.path))
+	{
+		// Renamed (rotation): the old file has been read to its end, follow the new one.
+		followed.file.Close();
+		followed.offset = 0;
+		if (OpenShared(followed.file, followed.path))
+		{
+			while (ReadAppended(followed));
+		}
+	}
+
+	for (FileDescriptor& fd : _data.GetFileData())
+	{
+		if (fd.path == followed.path && fd.offset != followed.offset)
+		{
+			fd.offset = followed.offset;
+			followed.stamped = false;
+		}
+	}
+}
+
+bool LogFollower::ReadAppended(FollowedFile& followed)
+{
+	if (!followed.file.IsOpened())
+	{
+		return false;
+	}
+	wxFileOffset length = followed.file.Length();
+	if (length < 0 || (uint64_t)length <= followed.offset || !followed.file.Seek(followed.offset))
+	{
+		return false;
+	}
+
+	std::vector<char> buffer(std::min<uint64_t>(length - followed.offset, READ_SIZE));
+	size_t size = followed.file.Read(buffer.data(), buffer.size());
+
+	// Only whole lines are parsed, the last one may still be written.
+	const char* begin = buffer.data();
+	const char* end = begin + size;
+	while (end > begin && end[-1] != '\n')
+	{
+		--end;
+	}
+	if (end == begin)
+	{
+		if (size < READ_SIZE)
+		{
+			return false;
+		}
+		// Line longer than the buffer
+		end = begin + size;
+	}
+
+	LogShard shard;
+	Parser parser(_data, _data.GetFileData());
+	parser.Parse(followed.id, begin, end, shard);
+	followed.offset += end - begin;
+	_data.Extend(followed.id, std::move(shard));
+	return true;
+}
+
+void LogFollower::OnTimer(wxTimerEvent& event)
+{
+	Check();
+}
+
+void LogFollower::OnFileSystemEvent(wxFileSystemWatcherEvent& event)
+{
+	// Gather close notifications, a writer may trigger a lot of them.
+	if (!_checkTimer.IsRunning())
+	{
+		_checkTimer.StartOnce(CHECK_DELAY);
+	}
+}
@@ -0,0 +1,95 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+* follower.hpp
+* Copyright (C) 2019 Emilien Kia <Emilien.Kia+dev@gmail.com>
+*
+* logviewer is free software: you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the
+* Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* logviewer is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _FOLLOWER_HPP_
+#define _FOLLOWER_HPP_
+
+#include <memory>
+#include <vector>
+
+#include <wx/event.h>
+#include <wx/ffile.h>
+#include <wx/timer.h>
+
+#include "data.hpp"
+
+class wxFileSystemWatcher;
+class wxFileSystemWatcherEvent;
+
+
+/**
+ * Follow the growth of loaded log files, like "tail -F".
+ * Only lines appended since the last parsing are parsed and appended to the
+ * log data. Directories of followed files are watched, so that truncated and
+ * renamed (rotated) files are noticed; a periodic check covers the file
+ * systems without change notification.
+ */
+class LogFollower : public wxEvtHandler
+{
+public:
+	LogFollower(LogData& data);
+	virtual ~LogFollower();
+
+	/** Start following all completely loaded files. */
+	void Start();
+	void Stop();
+	bool IsFollowing()const { return _following; }
+
+	/** Follow again the files of the file data, after files have been added, removed or reloaded. */
+	void Refresh();
+	/** Stop following files until the next refresh, stamping the ones which grew. */
+	void Clear();
+
+	/** Parse lines appended to followed files. */
+	void Check();
+
+protected:
+	struct FollowedFile
+	{
+		uint16_t id;
+		wxString path;
+		wxFFile file;
+		uint64_t offset;	// Size of the content already parsed
+		bool stamped = true;	// Whether the file descriptor stamp matches the offset
+	};
+
+	LogData& _data;
+	bool _following = false;
+	std::vector<std::unique_ptr<FollowedFile>> _followed;
+
+	wxFileSystemWatcher* _watcher = nullptr;
+	wxTimer _checkTimer, _pollTimer;
+
+	/** Delay gathering close change notifications, in milliseconds. */
+	static const int CHECK_DELAY = 20;
+	/** Period of checks without notification, in milliseconds. */
+	static const int POLL_PERIOD = 1000;
+	/** Maximal size read at once. */
+	static const size_t READ_SIZE = 16 * 1024 * 1024;
+
+	void Check(FollowedFile& followed);
+	bool ReadAppended(FollowedFile& followed);
+
+private:
+	void OnTimer(wxTimerEvent& event);
+	void OnFileSystemEvent(wxFileSystemWatcherEvent& event);
+};
+
+
+#endif /* _FOLLOWER_HPP_ */
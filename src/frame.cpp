@@ -28,6 +28,7 @@
 #include <wx/timectrl.h>
 #include <wx/dateevt.h>
 #include <wx/dnd.h>
+#include <wx/filename.h>
 #include <wx/sharedptr.h>
 #include <wx/regex.h>
 
@@ -165,17 +166,23 @@ wxFrame(NULL, wxID_ANY, wxGetApp().GetAppDisplayName(), wxDefaultPosition, wxSiz
 
 Frame::~Frame()
 {
+	wxGetApp().GetLoader().RemListener(this);
+	wxGetApp().GetLoader().Stop();
+	wxGetApp().GetFollower().Stop();
 	_manager.UnInit();
 }
 
 void Frame::init()
 {
-	_status = CreateStatusBar();
+	_status = CreateStatusBar(2);
+	int statusWidths[] = {-2, -1};
+	_status->SetStatusWidths(2, statusWidths);
 
 	_logModel = new LogListModel(wxGetApp().GetFilteredLogData());
 	_loggerModel = new LoggerListModel(wxGetApp().GetFilteredLogData());
 	_fileModel = new FileListModel(wxGetApp().GetFilteredLogData());
 	wxGetApp().GetLogData().AddListener(this);
+	wxGetApp().GetLoader().AddListener(this);
 
 	_manager.SetManagedWindow(this);
 
@@ -197,6 +204,9 @@ void Frame::init()
 				bar->AddButton(wxID_OPEN, "Open", wxRibbonBmp("document-open"));
 				bar->AddButton(ID_LV_FILE_MANAGE, "Manage", wxRibbonBmp("document-manage"));
 				bar->AddButton(wxID_CLEAR, "Clear", wxRibbonBmp("document-clear"));
+				bar->AddToggleButton(ID_LV_FILE_FOLLOW, "Follow", wxRibbonBmp("document-reload"), "Follow files, displaying new entries as they are written");
+				bar->AddToggleButton(ID_LV_FILE_COMPRESS, "Compress", wxRibbonBmp(wxART_HARDDISK), "Keep texts of entries compressed in memory, unpacking them when displayed");
+				bar->AddButton(ID_LV_FILE_CANCEL_LOAD, "Cancel", wxRibbonBmp(wxART_CROSS_MARK), "Cancel loading of files, keeping already loaded entries");
 			}
 			{
 				wxRibbonPanel *panel = new wxRibbonPanel(page, wxID_ANY, "Criticality");
@@ -335,6 +345,7 @@ void Frame::init()
 	entries.emplace_back(wxACCEL_ALT, WXK_RETURN, ID_LV_SHOW_EXTRA);
 	entries.emplace_back(wxACCEL_CTRL | wxACCEL_SHIFT, WXK_HOME, ID_LV_SET_BEGIN_DATE);
 	entries.emplace_back(wxACCEL_CTRL | wxACCEL_SHIFT, WXK_END, ID_LV_SET_END_DATE);
+	entries.emplace_back(wxACCEL_CTRL, 'G', ID_LV_GOTO_DATE);
 	entries.emplace_back(wxACCEL_CTRL, WXK_UP, ID_LV_FOCUS_PREVIOUS_CURRENT_LOGGER);
 	entries.emplace_back(wxACCEL_CTRL, WXK_DOWN, ID_LV_FOCUS_NEXT_CURRENT_LOGGER);
 	entries.emplace_back(wxACCEL_CTRL, WXK_NUMPAD_ADD, ID_LV_SHOW_ONLY_CURRENT_LOGGER);
@@ -354,7 +365,7 @@ void Frame::init()
 	SetIcons(wxArtProvider::GetIconBundle("logviewer"));
 }
 
-void Frame::Updated(LogData& data)
+void Frame::Changed(LogData& data, const LogChanges& changes)
 {
 	if(_status)
 	{
@@ -413,6 +424,34 @@ void Frame::Updated(LogData& data)
 	}
 }
 
+void Frame::LoadProgress(LogLoader& loader)
+{
+	if(_status)
+	{
+		double elapsed = loader.GetElapsed();
+		wxString str;
+		if(loader.IsRunning())
+		{
+			str << "Loading " << wxFileName::GetHumanReadableSize(wxULongLong(loader.GetBytes()));
+			if(loader.GetTotalBytes()>0)
+			{
+				str << " / " << wxFileName::GetHumanReadableSize(wxULongLong(loader.GetTotalBytes()));
+			}
+			if(elapsed>0)
+			{
+				str << " - " << wxFileName::GetHumanReadableSize(wxULongLong(loader.GetBytes()/elapsed)) << "/s";
+				str << " - " << (unsigned long long)(loader.GetLines()/elapsed) << " lines/s";
+			}
+		}
+		else
+		{
+			str << (loader.IsCancelled() ? "Loading cancelled after " : "Loaded ")
+				<< loader.GetLines() << " lines in " << wxString::Format("%.1f", elapsed) << " s";
+		}
+		_status->SetStatusText(str, 1);
+	}
+}
+
 BEGIN_EVENT_TABLE(Frame, wxFrame)
 	EVT_CUSTOM(wxEVT_COMMAND_RIBBONBUTTON_CLICKED, wxID_ANY, Frame::OnRibbonButtonClicked)
 
@@ -429,6 +468,7 @@ BEGIN_EVENT_TABLE(Frame, wxFrame)
 	EVT_MENU(ID_LV_SHOW_EXTRA, Frame::OnDisplayExtra)
 	EVT_MENU(ID_LV_SET_BEGIN_DATE, Frame::OnSetAsBegin)
 	EVT_MENU(ID_LV_SET_END_DATE, Frame::OnSetAsEnd)
+	EVT_MENU(ID_LV_GOTO_DATE, Frame::OnGoToDate)
 
 	EVT_RIBBONPANEL_EXTBUTTON_ACTIVATED(ID_LV_LOGGER_PANEL, Frame::OnLoggersExtButtonActivated)
 	EVT_DATAVIEW_ITEM_ACTIVATED(ID_LV_LOGGER_LISTBOX, Frame::OnLoggersItemActivated)
@@ -493,16 +533,14 @@ void Frame::OnLoggerShowNone(wxCommandEvent& event)
 void Frame::OnLoggerShowOnlyCurrent(wxCommandEvent& event)
 {
 	if (_logs->GetSelectedItemsCount() > 0) {
-		Entry& entry = _logModel->Get(_logs->GetSelection());
-		_loggerModel->GetData().DisplayOnlyLogger(entry.logger);
+		_loggerModel->GetData().DisplayOnlyLogger(_logModel->GetLogger(_logModel->GetPos(_logs->GetSelection())));
 	}
 }
 
 void Frame::OnLoggerShowAllButCurrent(wxCommandEvent& event)
 {
 	if (_logs->GetSelectedItemsCount() > 0) {
-		Entry& entry = _logModel->Get(_logs->GetSelection());
-		_loggerModel->GetData().DisplayAllButLogger(entry.logger);
+		_loggerModel->GetData().DisplayAllButLogger(_logModel->GetLogger(_logModel->GetPos(_logs->GetSelection())));
 	}
 
 }
@@ -511,13 +549,11 @@ void Frame::OnLoggerFocusPrevious(wxCommandEvent& event)
 {
 	if (_logs->GetSelectedItemsCount() > 0) {
 		int pos = _logModel->GetPos(_logs->GetSelection());
-		Entry& entry = _logModel->Get(pos);
-		int logger = entry.logger;
+		long logger = _logModel->GetLogger(pos);
 		while (pos > 0)
 		{
 			--pos;
-			Entry& e = _logModel->Get(pos);
-			if (e.logger == logger)
+			if (_logModel->GetLogger(pos) == logger)
 			{
 				wxDataViewItem item = _logModel->GetItem(pos);
 				_logs->Select(item);
@@ -532,12 +568,10 @@ void Frame::OnLoggerFocusNext(wxCommandEvent& event)
 {
 	if (_logs->GetSelectedItemsCount() > 0) {
 		int pos = _logModel->GetPos(_logs->GetSelection());
-		Entry& entry = _logModel->Get(pos);
-		int logger = entry.logger;
+		long logger = _logModel->GetLogger(pos);
 		while (++pos < (int)_logModel->GetCount())
 		{
-			Entry& e = _logModel->Get(pos);
-			if (e.logger == logger)
+			if (_logModel->GetLogger(pos) == logger)
 			{
 				wxDataViewItem item = _logModel->GetItem(pos);
 				_logs->Select(item);
@@ -566,7 +600,7 @@ void Frame::OnSetAsBegin(wxCommandEvent& event)
 	{
 		wxDataViewItem sel = _logs->GetSelection();
 		size_t row = _logModel->GetRow(sel);
-		Entry& entry = _logModel->Get(row);
+		Entry entry = _logModel->Get(row);
 		_begin->SetValue(entry.date);
 		_logModel->GetData().SetStartDate(entry.date);
 	}
@@ -578,12 +612,66 @@ void Frame::OnSetAsEnd(wxCommandEvent& event)
 	{
 		wxDataViewItem sel = _logs->GetSelection();
 		size_t row = _logModel->GetRow(sel);
-		Entry& entry = _logModel->Get(row);
+		Entry entry = _logModel->Get(row);
 		_end->SetValue(entry.date);
 		_logModel->GetData().SetEndDate(entry.date);
 	}
 }
 
+// Parse a date as formatted in the log view, milliseconds being optional.
+static bool ParseDate(const wxString& str, wxDateTime& date)
+{
+	wxString seconds = str.BeforeFirst(','), ms = str.AfterFirst(',');
+	if (!date.ParseISOCombined(seconds.Trim(), ' '))
+	{
+		return false;
+	}
+	if (!ms.IsEmpty())
+	{
+		long value;
+		if (!ms.Trim().ToLong(&value) || value < 0 || value > 999)
+		{
+			return false;
+		}
+		date.SetMillisecond(value);
+	}
+	return true;
+}
+
+void Frame::OnGoToDate(wxCommandEvent& event)
+{
+	FilteredLogData& data = _logModel->GetData();
+	if (data.EntryCount() == 0)
+	{
+		return;
+	}
+
+	wxDateTime date = data.GetEntryDate(0);
+	if (_logs->GetSelectedItemsCount() > 0)
+	{
+		date = data.GetEntryDate(_logModel->GetRow(_logs->GetSelection()));
+	}
+	wxString str = wxGetTextFromUser("Date and time to go to:", "Go to time", Formatter::FormatDate(date), this);
+	if (str.IsEmpty())
+	{
+		return;
+	}
+	if (!ParseDate(str.Trim(false), date))
+	{
+		wxLogError("Invalid date: %s", str);
+		return;
+	}
+
+	long pos = data.FindDate(date);
+	if (pos != wxNOT_FOUND)
+	{
+		wxDataViewItem item = _logModel->GetItem(pos);
+		_logs->UnselectAll();
+		_logs->Select(item);
+		_logs->EnsureVisible(item);
+	}
+}
+
 void Frame::OnLogContextMenu(wxDataViewEvent& event)
 {
 	if(_logs->GetSelectedItemsCount()>0)
@@ -593,6 +681,8 @@ void Frame::OnLogContextMenu(wxDataViewEvent& event)
 		menu.AppendSeparator();
 		menu.Append(ID_LV_SET_BEGIN_DATE, "Set as begin of time frame");
 		menu.Append(ID_LV_SET_END_DATE, "Set as end of time frame");
+		menu.AppendSeparator();
+		menu.Append(ID_LV_GOTO_DATE, "Go to time...");
 		_logs->PopupMenu(&menu);
 	}
 }
@@ -603,7 +693,7 @@ void Frame::OnLogSelChanged(wxDataViewEvent& /*event*/)
 	{
 		wxDataViewItem sel = _logs->GetSelection();
 		size_t row = _logModel->GetRow(sel);
-		Entry& entry = _logModel->Get(row);
+		Entry entry = _logModel->Get(row);
 		_extraText->SetValue(entry.extra);
 	}
 	else
@@ -779,7 +869,7 @@ void Frame::Search(bool dirNext)
 						break; // No cycle
 				}
 
-				if(find(_logModel->Get(next).message))
+				if(find(_logModel->GetMessage(next)))
 				{
 					wxDataViewItem item = _logModel->GetItem(next);
 					_logs->Select(item);
@@ -810,7 +900,7 @@ void Frame::Search(bool dirNext)
 				}
 				next--;
 
-				if(find(_logModel->Get(next).message))
+				if(find(_logModel->GetMessage(next)))
 				{
 					wxDataViewItem item = _logModel->GetItem(next);
 					_logs->Select(item);
@@ -64,7 +64,7 @@ protected:
 };
 
 
-class Frame: public wxFrame, public LogData::Listener
+class Frame: public wxFrame, public LogData::Listener, public LogLoader::Listener
 {
 	DECLARE_EVENT_TABLE()
 public:
@@ -79,7 +79,8 @@ public:
 protected:
 	void init();
 
-	virtual void Updated(LogData& data) override;
+	virtual void Changed(LogData& data, const LogChanges& changes) override;
+	virtual void LoadProgress(LogLoader& loader) override;
 
 	//void UpdateLoggerFilterFromListBox();
 	void UpdateListBoxFromLoggerFilter();
@@ -126,6 +127,7 @@ private:
 	void OnDisplayExtra(wxCommandEvent& event);
 	void OnSetAsBegin(wxCommandEvent& event);
 	void OnSetAsEnd(wxCommandEvent& event);
+	void OnGoToDate(wxCommandEvent& event);
 
 	void OnLoggersExtButtonActivated(wxRibbonPanelEvent& event);
 	void OnLoggersItemActivated(wxDataViewEvent& event);
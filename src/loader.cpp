@@ -0,0 +1,197 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+* loader.cpp
+* Copyright (C) 2019 Emilien Kia <Emilien.Kia+dev@gmail.com>
+*
+* logviewer is free software: you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the
+* Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* logviewer is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <wx/wx.h>
+
+#include <wx/filename.h>
+
+#include "loader.hpp"
+
+
+//
+// LogLoader
+//
+
+LogLoader::LogLoader(LogData& data):
+_data(data),
+_timer(this)
+{
+	Bind(wxEVT_TIMER, &LogLoader::OnTimer, this);
+}
+
+LogLoader::~LogLoader()
+{
+	Stop();
+}
+
+void LogLoader::Start(const std::vector<FileDescriptor*>& fds)
+{
+	Cancel();
+
+	_fds.clear();
+	_totalBytes = 0;
+	for (const FileDescriptor* fd : fds)
+	{
+		_fds.push_back(*fd);
+		wxULongLong size = wxFileName::GetSize(fd->path);
+		if (size != wxInvalidSize)
+		{
+			// Resumed files are only parsed after their offset.
+			uint64_t offset = fd->offset != FileDescriptor::UNKNOWN_OFFSET ? fd->offset : 0;
+			_totalBytes += size.GetValue() > offset ? size.GetValue() - offset : 0;
+		}
+	}
+
+	_progress.Reset();
+	_finished = false;
+	_start = _stop = std::chrono::steady_clock::now();
+	_thread = std::thread(&LogLoader::Run, this);
+	_timer.Start(REFRESH_PERIOD);
+	NotifyProgress();
+}
+
+void LogLoader::Cancel()
+{
+	if (IsRunning())
+	{
+		_progress.cancelled = true;
+		Finish();
+	}
+}
+
+void LogLoader::Stop()
+{
+	if (IsRunning())
+	{
+		_progress.cancelled = true;
+		_thread.join();
+		_timer.Stop();
+		_stop = std::chrono::steady_clock::now();
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pending.clear();
+	}
+}
+
+double LogLoader::GetElapsed()const
+{
+	std::chrono::steady_clock::time_point end = IsRunning() ? std::chrono::steady_clock::now() : _stop;
+	return std::chrono::duration<double>(end - _start).count();
+}
+
+void LogLoader::Run()
+{
+	// Worker thread: only touches its own descriptors and the pending shards.
+	std::vector<FileDescriptor*> fds;
+	for (FileDescriptor& fd : _fds)
+	{
+		fds.push_back(&fd);
+	}
+
+	Parser parser(_data, _data.GetFileData());
+	parser.SetProgress(&_progress);
+	parser.Parse(fds, [this](LogShard&& shard)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pending.push_back(std::move(shard));
+	});
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_finished = true;
+	}
+	CallAfter(&LogLoader::CheckFinished);
+}
+
+void LogLoader::Flush()
+{
+	std::vector<LogShard> shards;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::swap(shards, _pending);
+	}
+	if (shards.empty())
+	{
+		return;
+	}
+
+	for (LogShard& shard : shards)
+	{
+		_data.Append(std::move(shard));
+	}
+	_data.Synchronize();
+}
+
+void LogLoader::Finish()
+{
+	_thread.join();
+	_timer.Stop();
+	_stop = std::chrono::steady_clock::now();
+
+	// Report where parsing ended, for following and reloading files.
+	// Partially loaded files are resumed from there by the next load.
+	for (const FileDescriptor& loaded : _fds)
+	{
+		for (FileDescriptor& fd : _data.GetFileData())
+		{
+			if (fd.path == loaded.path)
+			{
+				fd.offset = loaded.offset;
+				fd.partial = loaded.partial;
+				fd.Stamp();
+			}
+		}
+	}
+	Flush();
+	NotifyProgress();
+}
+
+void LogLoader::CheckFinished()
+{
+	if (IsRunning())
+	{
+		bool finished;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			finished = _finished;
+		}
+		if (finished)
+		{
+			Finish();
+		}
+	}
+}
+
+void LogLoader::NotifyProgress()
+{
+	for (Listener* listener : _listeners)
+	{
+		listener->LoadProgress(*this);
+	}
+}
+
+void LogLoader::OnTimer(wxTimerEvent& event)
+{
+	Flush();
+	NotifyProgress();
+	CheckFinished();
+}
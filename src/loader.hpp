@@ -0,0 +1,110 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+* loader.hpp
+* Copyright (C) 2019 Emilien Kia <Emilien.Kia+dev@gmail.com>
+*
+* logviewer is free software: you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the
+* Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* logviewer is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _LOADER_HPP_
+#define _LOADER_HPP_
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <wx/event.h>
+#include <wx/timer.h>
+
+#include "data.hpp"
+#include "parser.hpp"
+
+
+/**
+ * Background loading of log files.
+ * Files are parsed by a worker thread, parsed entries are periodically
+ * appended to the log data from the GUI thread.
+ */
+class LogLoader : public wxEvtHandler
+{
+public:
+	struct Listener
+	{
+		/** Called periodically while loading and once when the load is finished. */
+		virtual void LoadProgress(LogLoader& loader) = 0;
+	};
+
+	LogLoader(LogData& data);
+	virtual ~LogLoader();
+
+	/** Start loading files, the current load (if any) is cancelled first. */
+	void Start(const std::vector<FileDescriptor*>& fds);
+	/** Cancel the current load, already parsed entries are kept.
+	 * Partially loaded files are marked as such, to be resumed by the next load. */
+	void Cancel();
+	/** Stop the current load without appending anything more to the log data. */
+	void Stop();
+
+	bool IsRunning()const { return _thread.joinable(); }
+	bool IsCancelled()const { return _progress.cancelled; }
+
+	uint64_t GetTotalBytes()const { return _totalBytes; }
+	uint64_t GetBytes()const { return _progress.bytes; }
+	uint64_t GetLines()const { return _progress.lines; }
+	/** Duration of the current (or last) load, in seconds. */
+	double GetElapsed()const;
+
+	// @name Listener management
+	// @{
+	void AddListener(Listener* listener) { _listeners.insert(listener); }
+	void RemListener(Listener* listener) { _listeners.erase(listener); }
+	// @}
+
+protected:
+	LogData& _data;
+
+	// Copies of descriptors of files being loaded
+	std::vector<FileDescriptor> _fds;
+
+	std::thread _thread;
+	ParseProgress _progress;
+	uint64_t _totalBytes = 0;
+	std::chrono::steady_clock::time_point _start, _stop;
+
+	// Shards parsed and not yet appended, protected by the mutex
+	std::mutex _mutex;
+	std::vector<LogShard> _pending;
+	bool _finished = false;
+
+	wxTimer _timer;
+
+	std::set<Listener*> _listeners;
+
+	/** Refresh period of the log data, in milliseconds. */
+	static const int REFRESH_PERIOD = 500;
+
+	void Run();
+	void Flush();
+	void Finish();
+	void CheckFinished();
+	void NotifyProgress();
+
+private:
+	void OnTimer(wxTimerEvent& event);
+};
+
+
+#endif /* _LOADER_HPP_ */
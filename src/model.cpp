@@ -40,24 +40,24 @@ size_t LogListModel::Count()const
 	return GetData().EntryCount();
 }
 
-const Entry& LogListModel::Get(size_t id)const
+Entry LogListModel::Get(size_t id)const
 {
 	return GetData().GetEntry(id);
 }
 
-Entry& LogListModel::Get(size_t id)
+Entry LogListModel::Get(wxDataViewItem item)const
 {
-	return GetData().GetEntry(id);
+	return Get(GetRow(item));
 }
 
-const Entry& LogListModel::Get(wxDataViewItem item)const
+long LogListModel::GetLogger(size_t id)const
 {
-	return Get(GetRow(item));
+	return GetData().GetLogData().GetEntryLogger(GetData().GetEntryIndex(id));
 }
 
-Entry& LogListModel::Get(wxDataViewItem item)
+wxString LogListModel::GetMessage(size_t id)const
 {
-	return Get(GetRow(item));
+	return GetData().GetLogData().GetEntryMessage(GetData().GetEntryIndex(id));
 }
 
 
@@ -81,29 +81,31 @@ wxString LogListModel::GetColumnType(unsigned int col)const
 
 void LogListModel::GetValueByRow(wxVariant &variant, unsigned int row, unsigned int col) const
 {
-	auto& entry = GetData().GetEntry(row);
+	// Only read the column to display.
+	const LogData& data = GetData().GetLogData();
+	size_t index = GetData().GetEntryIndex(row);
 	switch (col)
 	{
 	case LogListModel::DATE:
-		variant = Formatter::FormatDate(entry.date);
+		variant = Formatter::FormatDate(data.GetEntryDate(index));
 		return;
 	case LogListModel::CRITICALITY:
-		variant = Formatter::FormatCriticality(entry.criticality);
+		variant = Formatter::FormatCriticality(data.GetEntryCriticality(index));
 		return;
 	case LogListModel::THREAD:
-		variant = GetData().GetLogData().GetThreadLabel(entry.thread);
+		variant = data.GetThreadLabel(data.GetEntryThread(index));
 		return;
 	case LogListModel::LOGGER:
-		variant = GetData().GetLogData().GetLoggerLabel(entry.logger);
+		variant = data.GetLoggerLabel(data.GetEntryLogger(index));
 		return;
 	case LogListModel::SOURCE:
-		variant = GetData().GetLogData().GetSourceLabel(entry.source);
+		variant = data.GetSourceLabel(data.GetEntrySource(index));
 		return;
 	case LogListModel::MESSAGE:
-		variant = entry.message;
+		variant = data.GetEntryMessage(index);
 		return;
 	case LogListModel::EXTRA:
-		variant = !entry.extra.IsEmpty();
+		variant = data.HasEntryExtra(index);
 		return;
 	default:
 		return;
@@ -131,6 +133,27 @@ void LogListModel::Updated(FilteredLogData& data)
 	Update();
 }
 
+void LogListModel::Appended(FilteredLogData& data, size_t first)
+{
+	if (first != GetCount())
+	{
+		Update();
+		return;
+	}
+	for (size_t n = first; n < GetData().EntryCount(); ++n)
+	{
+		RowAppended();
+	}
+}
+
+void LogListModel::Modified(FilteredLogData& data, const std::vector<size_t>& rows)
+{
+	for (size_t row : rows)
+	{
+		RowChanged(row);
+	}
+}
+
 //
 // Logger List Model
 //
@@ -56,15 +56,17 @@ public:
 
 	// Model helpers
 	size_t Count()const;
-	const Entry& Get(size_t id)const;
-	Entry& Get(size_t id);
-	const Entry& Get(wxDataViewItem item)const;
-	Entry& Get(wxDataViewItem item);
+	Entry Get(size_t id)const;
+	Entry Get(wxDataViewItem item)const;
+	long GetLogger(size_t id)const;
+	wxString GetMessage(size_t id)const;
 	unsigned int GetPos(wxDataViewItem item)const;
 
 protected:
 	void Update();
 	virtual void Updated(FilteredLogData& data) override;
+	virtual void Appended(FilteredLogData& data, size_t first) override;
+	virtual void Modified(FilteredLogData& data, const std::vector<size_t>& rows) override;
 
 	FilteredLogData& _data;
 
@@ -22,263 +22,1033 @@
 #endif
 #include <wx/wx.h>
 
-#include <wx/wfstream.h>
-#include <wx/txtstrm.h>
 #include <wx/strconv.h>
 #include <wx/convauto.h>
 #include <wx/regex.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
 
 #include "parser.hpp"
+#include "reader.hpp"
 
 
 
 //
-// Log parser
+// Date parser
 //
 
-void Parser::ParseLogFiles(const wxArrayString& paths)
+static inline bool IsDigit(char c)
 {
-	for (auto path : paths)
+	return c >= '0' && c <= '9';
+}
+
+// Read exactly count digits.
+static inline bool ScanDigits(const char*& cur, const char* end, int count, int& value)
+{
+	if (end - cur < count)
 	{
-		ParseLogFile(path);
+		return false;
 	}
+	value = 0;
+	for (int n = 0; n < count; ++n, ++cur)
+	{
+		if (!IsDigit(*cur))
+		{
+			return false;
+		}
+		value = value * 10 + (*cur - '0');
+	}
+	return true;
+}
 
-	_data.Synchronize();
+// Read an optional separator among the specified ones.
+static inline void SkipSeparator(const char*& cur, const char* end, const char* separators)
+{
+	if (cur < end && *cur != 0 && strchr(separators, *cur) != nullptr)
+	{
+		++cur;
+	}
 }
 
-void Parser::ParseLogFile(const wxString& path)
+// Read a fraction of second (at least one digit), keeping milliseconds.
+static inline bool ScanFraction(const char*& cur, const char* end, int& millisecond)
 {
+	if (cur == end || !IsDigit(*cur))
+	{
+		return false;
+	}
+	millisecond = 0;
+	int n = 0;
+	for (; cur < end && IsDigit(*cur); ++cur, ++n)
+	{
+		if (n < 3)
+		{
+			millisecond = millisecond * 10 + (*cur - '0');
+		}
+	}
+	for (; n < 3; ++n)
+	{
+		millisecond *= 10;
+	}
+	return true;
+}
 
-	wxFFileInputStream file(path);
-	if (!file.IsOk())
+// Read a zone designator: Z, +hh, +hhmm or +hh:mm
+static inline bool ScanZone(const char*& cur, const char* end, int& offset)
+{
+	if (cur < end && *cur == 'Z')
 	{
-		wxLogError("Cannot open file %s", path);
-		return;
+		++cur;
+		offset = 0;
+		return true;
 	}
+	if (cur < end && (*cur == '+' || *cur == '-'))
+	{
+		int sign = *cur++ == '-' ? -1 : 1;
+		int h, m = 0;
+		if (!ScanDigits(cur, end, 2, h))
+		{
+			return false;
+		}
+		if (cur < end)
+		{
+			SkipSeparator(cur, end, ":");
+			if (!ScanDigits(cur, end, 2, m))
+			{
+				return false;
+			}
+		}
+		offset = sign * (h * 60 + m);
+		return true;
+	}
+	return false;
+}
 
-	Parse(_files.GetFile(path));
+static inline bool CheckFields(int month, int day, int hour, int minute, int second)
+{
+	return month >= 1 && month <= 12 && day >= 1 && day <= 31
+		&& hour <= 23 && minute <= 59 && second <= 61;
 }
 
-void Parser::Parse(FileDescriptor& fd)
+// Days since 1970-01-01 of a proleptic gregorian date.
+static long long DaysFromCivil(int y, int m, int d)
+{
+	y -= m <= 2;
+	const long long era = (y >= 0 ? y : y - 399) / 400;
+	const long long yoe = y - era * 400;
+	const long long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	const long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+void DateParser::Reset()
 {
-	wxFFileInputStream file(fd.path);
-	if (!file.IsOk())
+	_layout = LAYOUT_UNKNOWN;
+	_prefixLength = 0;
+	_localValid = false;
+}
+
+wxDateTime DateParser::Parse(const wxString& str)
+{
+	// All supported layouts are pure ASCII.
+	char buffer[64];
+	size_t len = 0;
+	for (wxString::const_iterator it = str.begin(); it != str.end(); ++it)
 	{
-		wxLogError("Cannot open file %s", fd.path);
-		return;
+		wxUniChar c = *it;
+		if (len >= sizeof(buffer) || !c.IsAscii())
+		{
+			return wxDateTime();
+		}
+		buffer[len++] = (char)c;
 	}
-	_fileDesc = &fd;
+	return Parse(buffer, buffer + len);
+}
 
-	_tempExtra.Empty();
+wxDateTime DateParser::Parse(const char* begin, const char* end)
+{
+	// Fast path: same date down to the second than previous one.
+	if (_prefixLength > 0 && (size_t)(end - begin) >= _prefixLength
+		&& memcmp(begin, _prefix, _prefixLength) == 0)
+	{
+		Fields fields = _fields;
+		if (ScanTail(_layout, begin + _prefixLength, end, fields))
+		{
+			return Convert(fields);
+		}
+	}
 
-	wxTextInputStream text(file);
-	while (!file.Eof())
+	Fields fields;
+	DATE_LAYOUT layout = LAYOUT_UNKNOWN;
+	if (_layout != LAYOUT_UNKNOWN && Scan(_layout, begin, end, fields))
 	{
-		ParseLogLine(text.ReadLine());
+		layout = _layout;
+	}
+	else
+	{
+		// (Re)detect the layout.
+		for (int l = LAYOUT_UNKNOWN + 1; l < LAYOUT_COUNT; ++l)
+		{
+			if (l != _layout && Scan((DATE_LAYOUT)l, begin, end, fields))
+			{
+				layout = (DATE_LAYOUT)l;
+				break;
+			}
+		}
+	}
+	if (layout == LAYOUT_UNKNOWN || fields.prefix > sizeof(_prefix))
+	{
+		return wxDateTime();
 	}
-	AppendExtraLine();
 
-	_fileDesc = nullptr;
+	_layout = layout;
+	memcpy(_prefix, begin, fields.prefix);
+	_prefixLength = fields.prefix;
+	_fields = fields;
+	_localValid = false;
+	if (layout == LAYOUT_EPOCH)
+	{
+		_naive = fields.epoch;
+	}
+	else
+	{
+		_naive = (DaysFromCivil(fields.year, fields.month, fields.day) * 86400
+			+ fields.hour * 3600 + fields.minute * 60 + fields.second) * 1000;
+	}
+	return Convert(fields);
+}
+
+wxDateTime DateParser::Convert(const Fields& fields)
+{
+	if (fields.zoned)
+	{
+		return wxDateTime(wxLongLong(_naive - fields.offset * 60000LL + fields.millisecond));
+	}
 
+	if (!_localValid)
+	{
+		// Local time conversion (with DST) is the expensive part, do it once per second.
+		_local = wxDateTime((wxDateTime::wxDateTime_t)fields.day, (wxDateTime::Month)(fields.month - 1), fields.year,
+			(wxDateTime::wxDateTime_t)fields.hour, (wxDateTime::wxDateTime_t)fields.minute, (wxDateTime::wxDateTime_t)fields.second).GetValue().GetValue();
+		_localValid = true;
+	}
+	return wxDateTime(wxLongLong(_local + fields.millisecond));
 }
 
+bool DateParser::Scan(DATE_LAYOUT layout, const char* begin, const char* end, Fields& fields)
+{
+	fields.millisecond = 0;
+	fields.zoned = false;
+	fields.offset = 0;
+	fields.epoch = 0;
+
+	bool res;
+	switch (layout)
+	{
+	case LAYOUT_DEFAULT:
+		res = ScanDefault(begin, end, fields);
+		break;
+	case LAYOUT_ISO8601:
+		res = ScanISO8601(begin, end, fields);
+		break;
+	case LAYOUT_SYSLOG:
+		res = ScanSyslog(begin, end, fields);
+		break;
+	case LAYOUT_EPOCH:
+		res = ScanEpoch(begin, end, fields);
+		break;
+	default:
+		return false;
+	}
+	return res && ScanTail(layout, begin + fields.prefix, end, fields);
+}
 
-void Parser::ParseLogLine(const wxString& line)
+bool DateParser::ScanTail(DATE_LAYOUT layout, const char* begin, const char* end, Fields& fields)
 {
-	if (!line.IsEmpty())
+	const char* cur = begin;
+	fields.millisecond = 0;
+	switch (layout)
 	{
-		wxArrayString arr = SplitLine(line);
-		if (!arr.IsEmpty())
+	case LAYOUT_DEFAULT:
+		// Optional [,.] followed by exactly 3 digits
+		if (cur < end)
 		{
-			if (arr[0].Length() < 28)
-				// 28 : arbitrary value greater than any supported text date length
+			if (*cur != ',' && *cur != '.')
 			{
-				if (arr.GetCount() == 3)
-				{
-					AddLogLine(arr[0], arr[1], arr[2]);
-					return;
-				}
-				else if (arr.GetCount() == 6)
-				{
-					AddLogLine(arr[0], arr[1], arr[2], arr[3], arr[4], arr[5]);
-					return;
-				}
+				return false;
+			}
+			++cur;
+			if (!ScanDigits(cur, end, 3, fields.millisecond))
+			{
+				return false;
 			}
-			// Consider as extra line
-			_tempExtra.Append(line).Append("\n");
 		}
+		return cur == end;
+	case LAYOUT_ISO8601:
+		// Optional fraction then optional zone
+		if (cur < end && (*cur == ',' || *cur == '.'))
+		{
+			++cur;
+			if (!ScanFraction(cur, end, fields.millisecond))
+			{
+				return false;
+			}
+		}
+		fields.zoned = cur < end;
+		fields.offset = 0;
+		if (fields.zoned && !ScanZone(cur, end, fields.offset))
+		{
+			return false;
+		}
+		return cur == end;
+	case LAYOUT_SYSLOG:
+	case LAYOUT_EPOCH:
+		// Optional fraction
+		if (cur < end)
+		{
+			if (*cur != ',' && *cur != '.')
+			{
+				return false;
+			}
+			++cur;
+			if (!ScanFraction(cur, end, fields.millisecond))
+			{
+				return false;
+			}
+		}
+		return cur == end;
+	default:
+		return false;
 	}
 }
 
-wxArrayString Parser::SplitLine(const wxString& line)
+bool DateParser::ScanDefault(const char* begin, const char* end, Fields& fields)
+{
+	// ^(\d{4})[\-\/ ]?(\d{2})[\-\/ ]?(\d{2})[T\- ](\d{2})[\: ]?(\d{2})[\: ]?(\d{2})
+	const char* cur = begin;
+	if (!ScanDigits(cur, end, 4, fields.year))
+		return false;
+	SkipSeparator(cur, end, "-/ ");
+	if (!ScanDigits(cur, end, 2, fields.month))
+		return false;
+	SkipSeparator(cur, end, "-/ ");
+	if (!ScanDigits(cur, end, 2, fields.day))
+		return false;
+	if (cur == end || (*cur != 'T' && *cur != '-' && *cur != ' '))
+		return false;
+	++cur;
+	if (!ScanDigits(cur, end, 2, fields.hour))
+		return false;
+	SkipSeparator(cur, end, ": ");
+	if (!ScanDigits(cur, end, 2, fields.minute))
+		return false;
+	SkipSeparator(cur, end, ": ");
+	if (!ScanDigits(cur, end, 2, fields.second))
+		return false;
+	fields.prefix = cur - begin;
+	return CheckFields(fields.month, fields.day, fields.hour, fields.minute, fields.second);
+}
+
+bool DateParser::ScanISO8601(const char* begin, const char* end, Fields& fields)
+{
+	// YYYY-MM-DDTHH:MM:SS, fraction and zone are scanned as tail
+	const char* cur = begin;
+	if (!ScanDigits(cur, end, 4, fields.year))
+		return false;
+	if (cur == end || *cur++ != '-')
+		return false;
+	if (!ScanDigits(cur, end, 2, fields.month))
+		return false;
+	if (cur == end || *cur++ != '-')
+		return false;
+	if (!ScanDigits(cur, end, 2, fields.day))
+		return false;
+	if (cur == end || (*cur != 'T' && *cur != ' '))
+		return false;
+	++cur;
+	if (!ScanDigits(cur, end, 2, fields.hour))
+		return false;
+	if (cur == end || *cur++ != ':')
+		return false;
+	if (!ScanDigits(cur, end, 2, fields.minute))
+		return false;
+	if (cur == end || *cur++ != ':')
+		return false;
+	if (!ScanDigits(cur, end, 2, fields.second))
+		return false;
+	fields.prefix = cur - begin;
+	return CheckFields(fields.month, fields.day, fields.hour, fields.minute, fields.second);
+}
+
+bool DateParser::ScanSyslog(const char* begin, const char* end, Fields& fields)
 {
-	wxArrayString arr;
-	size_t cur = 0;
-	size_t pos = 0;
-	while (pos = line.find(" | ", cur), pos != wxString::npos)
+	// Mmm dd HH:MM:SS, day may be padded with a space
+	static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+	const char* cur = begin;
+	if (end - cur < 15)
+		return false;
+	fields.month = 0;
+	for (int m = 0; m < 12; ++m)
 	{
-		arr.Add(line.SubString(cur, pos - 1));
-		cur = pos + 3;
-		if (cur >= line.Length()) {
+		if (memcmp(cur, months[m], 3) == 0)
+		{
+			fields.month = m + 1;
 			break;
 		}
 	}
-	if (cur<line.Length()) {
-		arr.Add(line.Mid(cur));
+	if (fields.month == 0 || cur[3] != ' ')
+		return false;
+	cur += 4;
+	if (*cur == ' ')
+	{
+		++cur;
+		if (!ScanDigits(cur, end, 1, fields.day))
+			return false;
 	}
-	return arr;
+	else if (!ScanDigits(cur, end, 2, fields.day))
+		return false;
+	if (cur == end || *cur++ != ' ')
+		return false;
+	if (!ScanDigits(cur, end, 2, fields.hour))
+		return false;
+	if (cur == end || *cur++ != ':')
+		return false;
+	if (!ScanDigits(cur, end, 2, fields.minute))
+		return false;
+	if (cur == end || *cur++ != ':')
+		return false;
+	if (!ScanDigits(cur, end, 2, fields.second))
+		return false;
+	fields.prefix = cur - begin;
+
+	// Year is not written, take the last occurrence of this day.
+	wxDateTime today = wxDateTime::Today();
+	fields.year = today.GetYear();
+	if (fields.month > today.GetMonth() + 1
+		|| (fields.month == today.GetMonth() + 1 && fields.day > today.GetDay()))
+	{
+		fields.year--;
+	}
+	return CheckFields(fields.month, fields.day, fields.hour, fields.minute, fields.second);
 }
 
-void Parser::AppendExtraLine()
+bool DateParser::ScanEpoch(const char* begin, const char* end, Fields& fields)
+{
+	// Seconds (9 to 11 digits) or milliseconds (12 to 14 digits) since 1970
+	const char* cur = begin;
+	long long value = 0;
+	for (; cur < end && IsDigit(*cur); ++cur)
+	{
+		value = value * 10 + (*cur - '0');
+	}
+	size_t digits = cur - begin;
+	if (digits < 9 || digits > 14)
+	{
+		return false;
+	}
+	fields.zoned = true;
+	fields.prefix = digits;
+	if (digits >= 12)
+	{
+		// Milliseconds, no fraction allowed
+		fields.epoch = value;
+		return cur == end;
+	}
+	fields.epoch = value * 1000;
+	return true;
+}
+
+
+//
+// Field delimiter scanner
+//
+// Look for the first " | " delimiter of a line. Three shifted loads are
+// compared so that one vector compare sequence validates whole delimiters.
+//
+
+static const char* FindDelimiterScalar(const char* begin, const char* end)
 {
-	if (!_tempExtra.IsEmpty())
+	const char* cur = begin + 1;
+	while (cur < end - 1 && (cur = (const char*)memchr(cur, '|', end - 1 - cur)) != nullptr)
 	{
-		if (_data.EntryCount()>0)
+		if (cur[-1] == ' ' && cur[1] == ' ')
 		{
-			_data.GetLastEntry().extra = _tempExtra;
+			return cur - 1;
 		}
-		_tempExtra.clear();
+		++cur;
 	}
+	return nullptr;
 }
 
-void Parser::AddLogLine(wxString date, wxString criticality, wxString thread, wxString logger, wxString source, wxString message)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LV_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LV_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+static inline unsigned CountTrailingZeros(unsigned mask)
 {
-	AppendExtraLine();
-	_data.AddLog(
-		ParseDate(date.Trim(false).Trim(true)),
-		_fileDesc->id,
-		ParseCriticality(criticality.Trim(false)),
-		thread,
-		logger,
-		source,
-		message
-	);
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
 }
 
-void Parser::AddLogLine(wxString date, wxString logger, wxString message)
+#ifdef LV_HAVE_SSE2
+static const char* FindDelimiterSSE2(const char* begin, const char* end)
 {
-	AppendExtraLine();
-	_data.AddLog(
-		ParseDate(date.Trim(false).Trim(true)),
-		_fileDesc->id,
-		CRITICALITY_LEVEL::LOG_INFO,
-		"",
-		logger.Trim(false).Trim(true),
-		"",
-		message.Trim(false).Trim(true)
-	);
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i pipe = _mm_set1_epi8('|');
+	const char* cur = begin;
+	for (; end - cur >= 18; cur += 16)
+	{
+		__m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)cur), space);
+		__m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cur + 1)), pipe);
+		__m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cur + 2)), space);
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a, b), c));
+		if (mask != 0)
+		{
+			return cur + CountTrailingZeros(mask);
+		}
+	}
+	return FindDelimiterScalar(cur, end);
 }
+#endif // LV_HAVE_SSE2
 
+#ifdef LV_HAVE_AVX2
+__attribute__((target("avx2")))
+static const char* FindDelimiterAVX2(const char* begin, const char* end)
+{
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i pipe = _mm256_set1_epi8('|');
+	const char* cur = begin;
+	for (; end - cur >= 34; cur += 32)
+	{
+		__m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)cur), space);
+		__m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(cur + 1)), pipe);
+		__m256i c = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(cur + 2)), space);
+		unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(a, b), c));
+		if (mask != 0)
+		{
+			return cur + CountTrailingZeros(mask);
+		}
+	}
+#ifdef LV_HAVE_SSE2
+	return FindDelimiterSSE2(cur, end);
+#else
+	return FindDelimiterScalar(cur, end);
+#endif
+}
+#endif // LV_HAVE_AVX2
 
-wxDateTime Parser::ParseDate(const wxString& str)
+const char* Parser::FindDelimiter(const char* begin, const char* end)
 {
-	long y = 0, mo = 0, d = 0, h = 0, m = 0, s = 0, ms = 0;
-	size_t start, len;
+#ifdef LV_HAVE_AVX2
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	if (avx2)
+	{
+		return FindDelimiterAVX2(begin, end);
+	}
+#endif
+#ifdef LV_HAVE_SSE2
+	return FindDelimiterSSE2(begin, end);
+#else
+	return FindDelimiterScalar(begin, end);
+#endif
+}
+
+
+//
+// Log parser
+//
 
-	wxRegEx reDate;;
-	if (!reDate.Compile("^(\\d{4})[\\-\\/ ]?(\\d{2})[\\-\\/ ]?(\\d{2})[T\\- ](\\d{2})[\\: ]?(\\d{2})[\\: ]?(\\d{2})([,.](\\d{3}))?$", wxRE_ADVANCED))
+void Parser::ParseLogFiles(const wxArrayString& paths)
+{
+	// Register all files first, descriptors may move while the list grows.
+	std::vector<uint16_t> ids;
+	for (auto path : paths)
 	{
-		std::cerr << "RegEx compilation error" << std::endl;
-		goto error;
+		ids.push_back(_files.GetFile(path).id);
 	}
-	if (reDate.Matches(str))
+	std::vector<FileDescriptor*> fds;
+	for (uint16_t id : ids)
 	{
-		// Grp 1 : year
-		if (reDate.GetMatch(&start, &len, 1))
+		fds.push_back(&_files.GetFile(id));
+	}
+	Parse(fds);
+
+	_data.Synchronize();
+}
+
+void Parser::ParseLogFile(const wxString& path)
+{
+	// Files which cannot be opened are reported when opening their reader.
+	Parse(_files.GetFile(path));
+}
+
+void Parser::Parse(FileDescriptor& fd)
+{
+	Parse(std::vector<FileDescriptor*>{&fd});
+}
+
+void Parser::Parse(const std::vector<FileDescriptor*>& fds)
+{
+	Parse(fds, [&](LogShard&& shard)
+	{
+		_data.Append(std::move(shard));
+	});
+}
+
+void Parser::Parse(const std::vector<FileDescriptor*>& fds, const std::function<void(LogShard&&)>& sink)
+{
+	struct Segment
+	{
+		uint16_t file;
+		const char* begin;
+		const char* end;
+		FileReader* reader;		// Streamed file, when not mapped
+		size_t opened;			// Position of the file in opened ones
+		bool resumed;			// File parsed from a known offset
+		uint64_t offset;		// End of the last parsed line
+		LogShard shard;
+		std::string tail;		// Unterminated last line, of streamed files
+		bool complete;			// Parsed up to its end, not cancelled
+		bool done;
+	};
+
+	// Cut mapped files into segments of whole lines, streamed ones are parsed as a whole.
+	// Files with a known offset are parsed from it, after their already parsed content.
+	// Unterminated last lines are parsed apart, they may still be written.
+	std::vector<std::unique_ptr<FileReader>> readers;
+	std::vector<FileDescriptor*> opened;
+	std::vector<uint64_t> offsets;
+	std::vector<StrView> tails;
+	std::vector<Segment> segments;
+	for (FileDescriptor* fd : fds)
+	{
+		std::unique_ptr<FileReader> reader = FileReader::Open(fd->path);
+		if (!reader)
 		{
-			if (!str.substr(start, len).ToLong(&y)) goto error;
+			wxLogError("Cannot open file %s", fd->path);
+			continue;
+		}
+
+		bool resumed = fd->offset != FileDescriptor::UNKNOWN_OFFSET && fd->offset > 0;
+		if (reader->GetData() != nullptr)
+		{
+			const char* end = reader->GetData() + reader->GetSize();
+			while (end > reader->GetData() && end[-1] != '\n')
+			{
+				--end;
+			}
+			const char* begin = SkipBOM(reader->GetData(), end);
+			const char* tail = std::max(end, SkipBOM(reader->GetData(), reader->GetData() + reader->GetSize()));
+			tails.push_back(StrView(tail, reader->GetData() + reader->GetSize()));
+			if (resumed)
+			{
+				begin = reader->GetData() + std::min<uint64_t>(fd->offset, end - reader->GetData());
+			}
+			while (begin < end)
+			{
+				const char* cut = (size_t)(end - begin) > SEGMENT_SIZE ? begin + SEGMENT_SIZE : end;
+				const char* eol = (const char*)memchr(cut, '\n', end - cut);
+				cut = eol != nullptr ? eol + 1 : end;
+				segments.push_back({ fd->id, begin, cut, nullptr, opened.size(), resumed, (uint64_t)(begin - reader->GetData()) });
+				begin = cut;
+			}
+			offsets.push_back(tail - reader->GetData());
 		}
 		else
 		{
-			std::cerr << "Regex not match year" << std::endl;
-			goto error;
+			if (resumed && !reader->Seek(fd->offset))
+			{
+				wxLogError("Cannot read file %s", fd->path);
+				continue;
+			}
+			segments.push_back({ fd->id, nullptr, nullptr, reader.get(), opened.size(), resumed, resumed ? fd->offset : 0 });
+			offsets.push_back(0);
+			tails.push_back(StrView());
 		}
+		readers.push_back(std::move(reader));
+		opened.push_back(fd);
+	}
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::atomic<size_t> next(0);
 
-		// Grp 2 : month
-		if (reDate.GetMatch(&start, &len, 2))
+	auto work = [&]()
+	{
+		Parser parser(_data, _files);
+		parser.SetProgress(_progress);
+		for (size_t n = next++; n < segments.size(); n = next++)
 		{
-			if (!str.substr(start, len).ToLong(&mo)) goto error;
+			Segment& segment = segments[n];
+			if (!IsCancelled())
+			{
+				if (segment.reader != nullptr)
+				{
+					segment.offset = parser.Parse(segment.file, *segment.reader, segment.shard, segment.tail);
+					segment.complete = !IsCancelled();
+				}
+				else
+				{
+					const char* reached = parser.Parse(segment.file, segment.begin, segment.end, segment.shard);
+					segment.offset += reached - segment.begin;
+					segment.complete = reached == segment.end;
+				}
+				// Compressed by workers rather than when appended.
+				if (_data.IsTextCompressed())
+				{
+					segment.shard.texts.Compress();
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				segment.done = true;
+			}
+			cond.notify_all();
 		}
-		else
+	};
+
+	std::vector<std::thread> workers;
+	size_t threads = std::min<size_t>(std::thread::hardware_concurrency(), segments.size());
+	if (threads <= 1)
+	{
+		work();
+	}
+	else
+	{
+		for (size_t n = 0; n < threads; ++n)
 		{
-			std::cerr << "Regex not match month" << std::endl;
-			goto error;
+			workers.emplace_back(work);
 		}
+	}
 
-		// Grp 3 : day
-		if (reDate.GetMatch(&start, &len, 3))
+	// Publish shards in order as soon as they are parsed. The last shard with
+	// entries is held back until the next one, which may begin with its extra lines.
+	// When cancelled, files are only published up to their first incomplete segment.
+	std::vector<bool> partial(opened.size(), false);
+	LogShard* held = nullptr;
+	for (Segment& segment : segments)
+	{
 		{
-			if (!str.substr(start, len).ToLong(&d)) goto error;
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]() { return segment.done; });
 		}
-		else
+		if (partial[segment.opened])
 		{
-			std::cerr << "Regex not match day" << std::endl;
-			goto error;
+			continue;
+		}
+		offsets[segment.opened] = segment.offset;
+		partial[segment.opened] = !segment.complete;
+		if (segment.reader != nullptr)
+		{
+			tails[segment.opened] = StrView(segment.tail.data(), segment.tail.data() + segment.tail.size());
 		}
 
-
-		// Grp 4 : hours
-		if (reDate.GetMatch(&start, &len, 4))
+		if (held != nullptr && held->entries.back().file != segment.file)
+		{
+			sink(std::move(*held));
+			held = nullptr;
+		}
+		if (held != nullptr && !segment.shard.leadingExtra.empty())
+		{
+			const std::string& extra = segment.shard.leadingExtra;
+			ShardEntry& last = held->entries.back();
+			last.extra = held->extraTable.Append(held->extras, last.extra, StrView(extra.data(), extra.data() + extra.size()));
+			segment.shard.leadingExtra.clear();
+		}
+		else if (!segment.resumed)
+		{
+			// Extra lines before the first entry of a file have no entry to belong to.
+			segment.shard.leadingExtra.clear();
+		}
+		if (segment.shard.entries.empty())
 		{
-			if (!str.substr(start, len).ToLong(&h)) goto error;
+			// Extra lines of a resumed file continue its last already parsed entry.
+			if (!segment.shard.leadingExtra.empty())
+			{
+				sink(std::move(segment.shard));
+			}
 		}
 		else
 		{
-			std::cerr << "Regex not match hours" << std::endl;
-			goto error;
+			if (held != nullptr)
+			{
+				sink(std::move(*held));
+			}
+			held = &segment.shard;
 		}
+	}
+	if (held != nullptr)
+	{
+		sink(std::move(*held));
+	}
 
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
 
-		// Grp 5 : minutes
-		if (reDate.GetMatch(&start, &len, 5))
+	// Unterminated last lines follow the whole ones, and are replaced once
+	// completed: they are parsed again from the offset before them.
+	for (size_t n = 0; n < opened.size(); ++n)
+	{
+		if (!partial[n] && !tails[n].empty())
 		{
-			if (!str.substr(start, len).ToLong(&m)) goto error;
+			LogShard shard;
+			Parse(opened[n]->id, tails[n].begin, tails[n].end, shard);
+			shard.tail = true;
+			sink(std::move(shard));
 		}
-		else
+	}
+
+	// Remember where parsing ended, to follow files afterward or to resume cancelled ones.
+	for (size_t n = 0; n < readers.size(); ++n)
+	{
+		// Compressed files can neither be followed nor resumed.
+		opened[n]->offset = readers[n]->IsCompressed() ? FileDescriptor::UNKNOWN_OFFSET : offsets[n];
+		opened[n]->partial = partial[n];
+	}
+}
+
+const char* Parser::Parse(uint16_t file, const char* begin, const char* end, LogShard& shard)
+{
+	Begin(file, shard);
+	while (begin < end && !IsCancelled())
+	{
+		// Progress is reported by slices of whole lines.
+		const char* stop = (size_t)(end - begin) > PROGRESS_STEP ? begin + PROGRESS_STEP : end;
+		const char* eol = (const char*)memchr(stop, '\n', end - stop);
+		stop = eol != nullptr ? eol + 1 : end;
+
+		const char* cur = ParseLogLines(begin, stop);
+		if (cur < stop)
 		{
-			std::cerr << "Regex not match minutes" << std::endl;
-			goto error;
+			// Last line, without end of line
+			ParseLogLine(cur, stop);
 		}
+		Report(stop - begin);
+		begin = stop;
+	}
+	End();
+	return begin;
+}
+
+uint64_t Parser::Parse(uint16_t file, FileReader& reader, LogShard& shard, std::string& tail)
+{
+	Begin(file, shard);
+
+	// Incomplete line spanning two blocks
+	std::string carry;
+	bool first = true;
 
+	// Progress is counted in bytes read from the file, compressed or not.
+	uint64_t input = reader.GetInputOffset();
 
-		// Grp 6 : seconds
-		if (reDate.GetMatch(&start, &len, 6))
+	const char* data;
+	size_t size;
+	while (!IsCancelled() && reader.Read(data, size))
+	{
+		const char* end = data + size;
+		if (first)
 		{
-			if (!str.substr(start, len).ToLong(&s)) goto error;
+			data = SkipBOM(data, end);
+			first = false;
 		}
-		else
+
+		if (!carry.empty())
 		{
-			std::cerr << "Regex not match seconds" << std::endl;
-			goto error;
+			const char* eol = (const char*)memchr(data, '\n', end - data);
+			if (eol == nullptr)
+			{
+				carry.append(data, end);
+				Report(reader.GetInputOffset() - input);
+				input = reader.GetInputOffset();
+				continue;
+			}
+			carry.append(data, eol);
+			ParseLogLine(carry.data(), carry.data() + carry.size());
+			carry.clear();
+			data = eol + 1;
 		}
 
+		data = ParseLogLines(data, end);
+		carry.assign(data, end);
+		Report(reader.GetInputOffset() - input);
+		input = reader.GetInputOffset();
+	}
+	End();
+	tail.swap(carry);
+	return reader.GetOffset() - tail.size();
+}
+
+void Parser::Report(size_t bytes)
+{
+	if (_progress != nullptr)
+	{
+		_progress->bytes += bytes;
+		_progress->lines += _lines;
+	}
+	_lines = 0;
+}
+
+void Parser::Begin(uint16_t file, LogShard& shard)
+{
+	_shard = &shard;
+	_shard->file = file;
+	_file = file;
+	_tempExtra.clear();
+	_dateParser.Reset();
+}
+
+void Parser::End()
+{
+	AppendExtraLine();
+	_shard = nullptr;
+}
 
-		// Grp 8 : milliseconds
-		if (reDate.GetMatch(&start, &len, 8))
+const char* Parser::SkipBOM(const char* begin, const char* end)
+{
+	if (end - begin >= 3 && memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+	{
+		return begin + 3;
+	}
+	return begin;
+}
+
+const char* Parser::ParseLogLines(const char* begin, const char* end)
+{
+	const char* eol;
+	while (begin < end && (eol = (const char*)memchr(begin, '\n', end - begin)) != nullptr)
+	{
+		ParseLogLine(begin, eol);
+		begin = eol + 1;
+	}
+	return begin;
+}
+
+void Parser::ParseLogLine(const char* begin, const char* end)
+{
+	++_lines;
+	if (begin < end && end[-1] == '\r')
+	{
+		--end;
+	}
+	if (begin == end)
+	{
+		return;
+	}
+
+	StrView fields[7];
+	size_t count = SplitLine(begin, end, fields, 7);
+	if (fields[0].size() < 40)
+		// 40 : arbitrary value greater than any supported text date length
+	{
+		if (count == 3)
 		{
-			if (!str.substr(start, len).ToLong(&ms)) goto error;
+			AddLogLine(fields[0], fields[1], fields[2]);
+			return;
 		}
-		else ms = 0;
+		else if (count == 6)
+		{
+			AddLogLine(fields[0], fields[1], fields[2], fields[3], fields[4], fields[5]);
+			return;
+		}
+	}
+	// Consider as extra line
+	_tempExtra.append(begin, end).append(1, '\n');
+}
 
-		return wxDateTime(d, (wxDateTime::Month)(mo - 1), y, h, m, s, ms);
+size_t Parser::SplitLine(const char* begin, const char* end, StrView* fields, size_t maxFields)
+{
+	size_t count = 0;
+	const char* cur = begin;
+	const char* pos;
+	while (count < maxFields && (pos = FindDelimiter(cur, end)) != nullptr)
+	{
+		fields[count++] = StrView(cur, pos).Trim();
+		cur = pos + 3;
+		if (cur >= end) {
+			return count;
+		}
 	}
-	else
+	if (count < maxFields && cur < end) {
+		fields[count++] = StrView(cur, end).Trim();
+	}
+	return count;
+}
+
+void Parser::AppendExtraLine()
+{
+	if (!_tempExtra.empty())
 	{
-		std::cerr << "Regex not match" << std::endl;
+		if (!_shard->entries.empty())
+		{
+			_shard->entries.back().extra = _shard->extraTable.Intern(_shard->extras, StrView(_tempExtra.data(), _tempExtra.data() + _tempExtra.size()));
+		}
+		else
+		{
+			_shard->leadingExtra = _tempExtra;
+		}
+		_tempExtra.clear();
 	}
+}
 
-error:
-	return wxDateTime();
+void Parser::AddLogLine(StrView date, StrView criticality, StrView thread, StrView logger, StrView source, StrView message)
+{
+	AppendExtraLine();
+	_shard->AddLog(
+		_dateParser.Parse(date.begin, date.end),
+		_file,
+		ParseCriticality(criticality),
+		thread,
+		logger,
+		source,
+		message
+	);
+}
+
+void Parser::AddLogLine(StrView date, StrView logger, StrView message)
+{
+	AppendExtraLine();
+	_shard->AddLog(
+		_dateParser.Parse(date.begin, date.end),
+		_file,
+		CRITICALITY_LEVEL::LOG_INFO,
+		StrView(),
+		logger,
+		StrView(),
+		message
+	);
+}
+
+
+wxDateTime Parser::ParseDate(const wxString& str)
+{
+	DateParser parser;
+	return parser.Parse(str);
 }
 
-CRITICALITY_LEVEL Parser::ParseCriticality(const wxString& str)
+CRITICALITY_LEVEL Parser::ParseCriticality(StrView str)
 {
-	if (str.IsEmpty())
+	if (str.empty())
 	{
 		return CRITICALITY_LEVEL::LOG_UNKNWON;
 	}
-	switch ((char)str[0])
+	switch (*str.begin)
 	{
 	case 'I':
 		return CRITICALITY_LEVEL::LOG_INFO;
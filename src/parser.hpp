@@ -20,38 +20,158 @@
 #ifndef _PARSER_HPP_
 #define _PARSER_HPP_
 
+#include <atomic>
+#include <functional>
+
 #include "data.hpp"
 
 enum CRITICALITY_LEVEL;
 
+
+/**
+ * Hand-written timestamp scanner.
+ * The layout is detected on the first parsed date and kept for the following
+ * ones. Consecutive dates sharing the same text down to the second reuse the
+ * already converted value and only parse the remaining fraction.
+ */
+class DateParser
+{
+public:
+	enum DATE_LAYOUT
+	{
+		LAYOUT_UNKNOWN,
+		LAYOUT_DEFAULT,		// 2019-10-17 12:00:00,123 and separator variants
+		LAYOUT_ISO8601,		// 2019-10-17T12:00:00.123456+02:00
+		LAYOUT_SYSLOG,		// Oct 17 12:00:00
+		LAYOUT_EPOCH,		// 1571313600.123 or 1571313600123
+
+		LAYOUT_COUNT
+	};
+
+	DateParser() = default;
+
+	void Reset();
+	DATE_LAYOUT GetLayout()const { return _layout; }
+
+	wxDateTime Parse(const wxString& str);
+	wxDateTime Parse(const char* begin, const char* end);
+
+protected:
+	/** Broken-down date, as scanned from text. */
+	struct Fields
+	{
+		int year, month, day, hour, minute, second;
+		int millisecond;
+		bool zoned;
+		int offset;		// Zone offset, in minutes
+		long long epoch;	// Milliseconds since 1970, for epoch layout only
+		size_t prefix;	// Length of text down to the second
+	};
+
+	static bool Scan(DATE_LAYOUT layout, const char* begin, const char* end, Fields& fields);
+	static bool ScanDefault(const char* begin, const char* end, Fields& fields);
+	static bool ScanISO8601(const char* begin, const char* end, Fields& fields);
+	static bool ScanSyslog(const char* begin, const char* end, Fields& fields);
+	static bool ScanEpoch(const char* begin, const char* end, Fields& fields);
+	static bool ScanTail(DATE_LAYOUT layout, const char* begin, const char* end, Fields& fields);
+
+	wxDateTime Convert(const Fields& fields);
+
+	DATE_LAYOUT _layout = LAYOUT_UNKNOWN;
+
+	// Last scanned text down to the second and its converted values.
+	char _prefix[40];
+	size_t _prefixLength = 0;
+	Fields _fields;
+	long long _naive = 0;		// Milliseconds of fields considered as UTC
+	long long _local = 0;		// Milliseconds of fields considered as local time
+	bool _localValid = false;
+};
+
+
+/**
+ * Progress of a parsing, shared by all parsing threads.
+ */
+struct ParseProgress
+{
+	std::atomic<uint64_t> bytes{0};
+	std::atomic<uint64_t> lines{0};
+	std::atomic<bool> cancelled{false};
+
+	void Reset() { bytes = 0; lines = 0; cancelled = false; }
+};
+
+
+class FileReader;
+
 class Parser
 {
 protected:
 	FileData & _files;
 	LogData & _data;
+	ParseProgress* _progress = nullptr;
+
+	// Parsing state
+	LogShard* _shard = nullptr;
+	uint16_t _file = 0;
+	std::string _tempExtra;	// UTF-8
+	DateParser _dateParser;
+	size_t _lines = 0;
+
+	/** Size of file segments parsed concurrently. */
+	static const size_t SEGMENT_SIZE = 8 * 1024 * 1024;
+	/** Size of slices between two progress reports. */
+	static const size_t PROGRESS_STEP = 1024 * 1024;
 
-	wxString _tempExtra;
+	void Begin(uint16_t file, LogShard& shard);
+	void End();
 
-	FileDescriptor* _fileDesc;
+	bool IsCancelled()const { return _progress != nullptr && _progress->cancelled; }
+	void Report(size_t bytes);
 
-	void ParseLogLine(const wxString& line);
+	const char* ParseLogLines(const char* begin, const char* end);
+	void ParseLogLine(const char* begin, const char* end);
 
-	void AddLogLine(wxString date, wxString logger, wxString message);
-	void AddLogLine(wxString date, wxString criticality, wxString thread, wxString logger, wxString source, wxString message);
+	void AddLogLine(StrView date, StrView logger, StrView message);
+	void AddLogLine(StrView date, StrView criticality, StrView thread, StrView logger, StrView source, StrView message);
 
 	void AppendExtraLine();
 
 public:
-	Parser(LogData& data, FileData& files) :_data(data), _files(files) {}
+	Parser(LogData& data, FileData& files) :_files(files), _data(data) {}
 
 	void ParseLogFiles(const wxArrayString& paths);
 	void ParseLogFile(const wxString& path);
 
-	void Parse(FileDescriptor& fd);
+	/** Report progress to the specified counters, which can also cancel the parsing. */
+	void SetProgress(ParseProgress* progress) { _progress = progress; }
 
-	static wxArrayString SplitLine(const wxString& line);
+	/** Parse a whole file and append its entries to the log data. */
+	void Parse(FileDescriptor& fd);
+	/** Parse several files and append their entries to the log data, in the given order. */
+	void Parse(const std::vector<FileDescriptor*>& fds);
+	/** Parse several files concurrently, large mapped files being cut in segments.
+	 * Resulting shards are passed to the sink from the calling thread, in file and line order,
+	 * those of unterminated last lines coming last. */
+	void Parse(const std::vector<FileDescriptor*>& fds, const std::function<void(LogShard&&)>& sink);
+
+	/** Parse a range of whole lines into a shard.
+	 * Return the end of the last parsed line, before end when cancelled. */
+	const char* Parse(uint16_t file, const char* begin, const char* end, LogShard& shard);
+	/** Parse sequentially the content of a reader into a shard.
+	 * The last line is not parsed if not ended, it is returned in tail.
+	 * Return the offset after the last parsed line. */
+	uint64_t Parse(uint16_t file, FileReader& reader, LogShard& shard, std::string& tail);
+
+	/** Split a line on " | " delimiters into trimmed fields, stopping after maxFields.
+	 * Return the number of fields found. */
+	static size_t SplitLine(const char* begin, const char* end, StrView* fields, size_t maxFields);
+	/** Pointer on the first " | " delimiter of the range, nullptr if none. */
+	static const char* FindDelimiter(const char* begin, const char* end);
+
+	static const char* SkipBOM(const char* begin, const char* end);
 	static wxDateTime ParseDate(const wxString& str);
-	static CRITICALITY_LEVEL ParseCriticality(const wxString& str);
+	static CRITICALITY_LEVEL ParseCriticality(StrView str);
 };
 
 
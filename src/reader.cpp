@@ -0,0 +1,810 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+* reader.cpp
+* Copyright (C) 2019 Emilien Kia <Emilien.Kia+dev@gmail.com>
+*
+* logviewer is free software: you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the
+* Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* logviewer is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <wx/wx.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "reader.hpp"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#if defined(__WINDOWS__)
+#include <wx/msw/wrapwin.h>
+#elif defined(__UNIX__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+//
+// FileReader
+//
+
+std::unique_ptr<FileReader> FileReader::Open(const wxString& path)
+{
+	std::unique_ptr<FileReader> reader;
+	COMPRESSION compression = COMPRESSION_NONE;
+
+	std::unique_ptr<MappedFileReader> mapped(new MappedFileReader);
+	if (mapped->Open(path))
+	{
+		compression = DetectCompression(mapped->GetData(), mapped->GetSize());
+		reader = std::move(mapped);
+	}
+	else
+	{
+		std::unique_ptr<BufferedFileReader> buffered(new BufferedFileReader);
+		if (!buffered->Open(path))
+		{
+			return nullptr;
+		}
+		const char* data;
+		size_t size;
+		if (buffered->Peek(data, size))
+		{
+			compression = DetectCompression(data, size);
+		}
+		reader = std::move(buffered);
+	}
+
+	if (compression != COMPRESSION_NONE)
+	{
+		return OpenCompressed(compression, std::move(reader));
+	}
+	return reader;
+}
+
+FileReader::COMPRESSION FileReader::DetectCompression(const char* data, size_t size)
+{
+	if (size >= 3 && memcmp(data, "\x1F\x8B\x08", 3) == 0)
+	{
+		return COMPRESSION_GZIP;
+	}
+	if (size >= 4 && memcmp(data, "\x28\xB5\x2F\xFD", 4) == 0)
+	{
+		return COMPRESSION_ZSTD;
+	}
+	if (size >= 6 && memcmp(data, "\xFD" "7zXZ\0", 6) == 0)
+	{
+		return COMPRESSION_XZ;
+	}
+	return COMPRESSION_NONE;
+}
+
+uint64_t FileReader::Fingerprint(const wxString& path, uint64_t length)
+{
+	// Hashing whole files would cost as much as parsing them again: only the
+	// head and the tail of the content are hashed, with its length.
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+	wxFFile file(path, "rb");
+	if (!file.IsOpened())
+	{
+		return 0;
+	}
+
+	uint64_t hash = 14695981039346656037ULL;	// FNV-1a
+	auto update = [&](const char* data, size_t size)
+	{
+		for (size_t n = 0; n < size; ++n)
+		{
+			hash = (hash ^ (unsigned char)data[n]) * 1099511628211ULL;
+		}
+	};
+	update((const char*)&length, sizeof(length));
+
+	std::vector<char> buffer(BLOCK_SIZE);
+	size_t head = (size_t)std::min<uint64_t>(length, BLOCK_SIZE);
+	if (file.Read(buffer.data(), head) != head)
+	{
+		return 0;
+	}
+	update(buffer.data(), head);
+
+	if (length > BLOCK_SIZE)
+	{
+		size_t tail = (size_t)std::min<uint64_t>(length - BLOCK_SIZE, BLOCK_SIZE);
+		if (!file.Seek(length - tail) || file.Read(buffer.data(), tail) != tail)
+		{
+			return 0;
+		}
+		update(buffer.data(), tail);
+	}
+	return hash != 0 ? hash : 1;
+}
+
+std::unique_ptr<FileReader> FileReader::OpenCompressed(COMPRESSION compression, std::unique_ptr<FileReader> source)
+{
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<FramesFileReader::Frame> frames;
+	if (source->GetData() != nullptr && threads > 1
+		&& FramesFileReader::SplitFrames(compression, source->GetData(), source->GetSize(), frames)
+		&& frames.size() > 1)
+	{
+		return std::unique_ptr<FileReader>(new FramesFileReader(std::move(source), compression, std::move(frames)));
+	}
+
+	std::unique_ptr<Decompressor> decompressor = Decompressor::Create(compression, threads);
+	if (!decompressor)
+	{
+		wxLogError("This kind of compressed file is not supported");
+		return nullptr;
+	}
+	return std::unique_ptr<FileReader>(new DecompressFileReader(std::move(source), std::move(decompressor)));
+}
+
+
+//
+// MappedFileReader
+//
+
+MappedFileReader::~MappedFileReader()
+{
+	Close();
+}
+
+#if defined(__WINDOWS__)
+
+bool MappedFileReader::Open(const wxString& path)
+{
+	Close();
+
+	HANDLE file = ::CreateFileW(path.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file, &size) || (unsigned long long)size.QuadPart > (size_t)-1)
+	{
+		::CloseHandle(file);
+		return false;
+	}
+	_file = file;
+	_size = (size_t)size.QuadPart;
+	if (_size == 0)
+	{
+		// Empty files cannot be mapped but are valid.
+		return true;
+	}
+
+	_mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping != nullptr)
+	{
+		_data = (const char*) ::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+	if (_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFileReader::Close()
+{
+	if (_data != nullptr)
+	{
+		::UnmapViewOfFile(_data);
+	}
+	if (_mapping != nullptr)
+	{
+		::CloseHandle(_mapping);
+	}
+	if (_file != nullptr)
+	{
+		::CloseHandle(_file);
+	}
+	_data = nullptr;
+	_mapping = _file = nullptr;
+	_size = 0;
+	_delivered = false;
+}
+
+#elif defined(__UNIX__)
+
+bool MappedFileReader::Open(const wxString& path)
+{
+	Close();
+
+	int fd = ::open(path.fn_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (unsigned long long)st.st_size > (size_t)-1)
+	{
+		// Pipes, devices and too large files shall be read with buffers.
+		::close(fd);
+		return false;
+	}
+
+	_size = (size_t)st.st_size;
+	if (_size > 0)
+	{
+		void* addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			::close(fd);
+			_size = 0;
+			return false;
+		}
+		::madvise(addr, _size, MADV_SEQUENTIAL);
+		_data = (const char*)addr;
+	}
+
+	// The mapping stays valid after closing its descriptor.
+	::close(fd);
+	return true;
+}
+
+void MappedFileReader::Close()
+{
+	if (_data != nullptr)
+	{
+		::munmap((void*)_data, _size);
+	}
+	_data = nullptr;
+	_size = 0;
+	_delivered = false;
+}
+
+#else // Neither windows nor unix
+
+bool MappedFileReader::Open(const wxString& path)
+{
+	return false;
+}
+
+void MappedFileReader::Close()
+{
+}
+
+#endif
+
+bool MappedFileReader::Read(const char*& data, size_t& size)
+{
+	if (_delivered || _size == 0)
+	{
+		return false;
+	}
+	data = _data;
+	size = _size;
+	_delivered = true;
+	return true;
+}
+
+
+//
+// BufferedFileReader
+//
+
+bool BufferedFileReader::Open(const wxString& path)
+{
+	return _file.Open(path, "rb");
+}
+
+bool BufferedFileReader::Read(const char*& data, size_t& size)
+{
+	if (_peeked > 0)
+	{
+		size = _peeked;
+		_peeked = 0;
+	}
+	else
+	{
+		if (!_file.IsOpened() || _file.Eof())
+		{
+			return false;
+		}
+		size = _file.Read(_buffer.data(), _buffer.size());
+	}
+	data = _buffer.data();
+	_offset += size;
+	return size > 0;
+}
+
+bool BufferedFileReader::Seek(uint64_t offset)
+{
+	if (!_file.IsOpened() || !_file.Seek(offset))
+	{
+		return false;
+	}
+	_peeked = 0;
+	_offset = offset;
+	return true;
+}
+
+bool BufferedFileReader::Peek(const char*& data, size_t& size)
+{
+	if (_peeked == 0 && _offset == 0 && _file.IsOpened() && !_file.Eof())
+	{
+		_peeked = _file.Read(_buffer.data(), _buffer.size());
+	}
+	data = _buffer.data();
+	size = _peeked;
+	return size > 0;
+}
+
+
+//
+// Decompressors
+//
+
+#ifdef HAVE_ZLIB
+class GzipDecompressor : public Decompressor
+{
+public:
+	GzipDecompressor()
+	{
+		memset(&_stream, 0, sizeof(_stream));
+		// Automatic gzip or zlib header detection
+		_ok = ::inflateInit2(&_stream, 15 + 32) == Z_OK;
+	}
+
+	virtual ~GzipDecompressor()
+	{
+		::inflateEnd(&_stream);
+	}
+
+	virtual bool Process(const char*& in, size_t& inSize, char*& out, size_t& outSize, bool finish) override
+	{
+		for (;;)
+		{
+			if (_ended)
+			{
+				if (inSize == 0)
+				{
+					return true;
+				}
+				if ((unsigned char)*in != 0x1F)
+				{
+					// Trailing garbage (padding), ignored as gzip does.
+					in += inSize;
+					inSize = 0;
+					return true;
+				}
+				// Following member
+				::inflateReset(&_stream);
+				_ended = false;
+			}
+
+			_stream.next_in = (Bytef*)in;
+			_stream.avail_in = (uInt)std::min<size_t>(inSize, UINT_MAX);
+			_stream.next_out = (Bytef*)out;
+			_stream.avail_out = (uInt)std::min<size_t>(outSize, UINT_MAX);
+			int res = ::inflate(&_stream, Z_NO_FLUSH);
+
+			size_t consumed = (const char*)_stream.next_in - in;
+			size_t produced = (char*)_stream.next_out - out;
+			in += consumed;
+			inSize -= consumed;
+			out += produced;
+			outSize -= produced;
+
+			if (res == Z_STREAM_END)
+			{
+				_ended = true;
+			}
+			else if (res == Z_BUF_ERROR || (consumed == 0 && produced == 0))
+			{
+				// Needs more input or more output space
+				return true;
+			}
+			else if (res != Z_OK)
+			{
+				return false;
+			}
+		}
+	}
+
+protected:
+	z_stream _stream;
+	bool _ended = false;
+};
+#endif // HAVE_ZLIB
+
+#ifdef HAVE_ZSTD
+class ZstdDecompressor : public Decompressor
+{
+public:
+	ZstdDecompressor()
+	{
+		_ctx = ::ZSTD_createDCtx();
+		_ok = _ctx != nullptr;
+	}
+
+	virtual ~ZstdDecompressor()
+	{
+		::ZSTD_freeDCtx(_ctx);
+	}
+
+	virtual bool Process(const char*& in, size_t& inSize, char*& out, size_t& outSize, bool finish) override
+	{
+		// Consecutive frames are decompressed one after the other.
+		ZSTD_inBuffer input = { in, inSize, 0 };
+		ZSTD_outBuffer output = { out, outSize, 0 };
+		size_t res = ::ZSTD_decompressStream(_ctx, &output, &input);
+		in += input.pos;
+		inSize -= input.pos;
+		out += output.pos;
+		outSize -= output.pos;
+		return !::ZSTD_isError(res);
+	}
+
+protected:
+	ZSTD_DCtx* _ctx;
+};
+#endif // HAVE_ZSTD
+
+#ifdef HAVE_LZMA
+class XzDecompressor : public Decompressor
+{
+public:
+	XzDecompressor(unsigned threads)
+	{
+		_stream = LZMA_STREAM_INIT;
+#if LZMA_VERSION >= 50040002
+		if (threads > 1)
+		{
+			// Blocks of multi-threaded compressed files are decompressed in parallel.
+			lzma_mt mt;
+			memset(&mt, 0, sizeof(mt));
+			mt.flags = LZMA_CONCATENATED;
+			mt.threads = threads;
+			mt.memlimit_threading = ::lzma_physmem() / 4;
+			mt.memlimit_stop = UINT64_MAX;
+			_ok = ::lzma_stream_decoder_mt(&_stream, &mt) == LZMA_OK;
+			return;
+		}
+#endif
+		_ok = ::lzma_stream_decoder(&_stream, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+	}
+
+	virtual ~XzDecompressor()
+	{
+		::lzma_end(&_stream);
+	}
+
+	virtual bool Process(const char*& in, size_t& inSize, char*& out, size_t& outSize, bool finish) override
+	{
+		_stream.next_in = (const uint8_t*)in;
+		_stream.avail_in = inSize;
+		_stream.next_out = (uint8_t*)out;
+		_stream.avail_out = outSize;
+		lzma_ret res = ::lzma_code(&_stream, finish ? LZMA_FINISH : LZMA_RUN);
+
+		size_t consumed = (const char*)_stream.next_in - in;
+		size_t produced = (char*)_stream.next_out - out;
+		in += consumed;
+		inSize -= consumed;
+		out += produced;
+		outSize -= produced;
+		return res == LZMA_OK || res == LZMA_STREAM_END || res == LZMA_BUF_ERROR;
+	}
+
+protected:
+	lzma_stream _stream;
+};
+#endif // HAVE_LZMA
+
+std::unique_ptr<Decompressor> Decompressor::Create(FileReader::COMPRESSION compression, unsigned threads)
+{
+	std::unique_ptr<Decompressor> decompressor;
+	switch (compression)
+	{
+#ifdef HAVE_ZLIB
+	case FileReader::COMPRESSION_GZIP:
+		decompressor.reset(new GzipDecompressor);
+		break;
+#endif // HAVE_ZLIB
+#ifdef HAVE_ZSTD
+	case FileReader::COMPRESSION_ZSTD:
+		decompressor.reset(new ZstdDecompressor);
+		break;
+#endif // HAVE_ZSTD
+#ifdef HAVE_LZMA
+	case FileReader::COMPRESSION_XZ:
+		decompressor.reset(new XzDecompressor(threads));
+		break;
+#endif // HAVE_LZMA
+	default:
+		break;
+	}
+	if (decompressor && !decompressor->_ok)
+	{
+		decompressor.reset();
+	}
+	return decompressor;
+}
+
+
+//
+// DecompressFileReader
+//
+
+DecompressFileReader::DecompressFileReader(std::unique_ptr<FileReader> source, std::unique_ptr<Decompressor> decompressor, size_t blockSize):
+_source(std::move(source)),
+_decompressor(std::move(decompressor)),
+_buffer(blockSize)
+{
+}
+
+bool DecompressFileReader::Read(const char*& data, size_t& size)
+{
+	if (!_decompressor)
+	{
+		return false;
+	}
+
+	char* out = _buffer.data();
+	size_t outSize = _buffer.size();
+	while (outSize > 0)
+	{
+		if (_inputSize == 0 && !_inputEnd && !_source->Read(_input, _inputSize))
+		{
+			_inputEnd = true;
+		}
+
+		size_t inBefore = _inputSize, outBefore = outSize;
+		if (!_decompressor->Process(_input, _inputSize, out, outSize, _inputEnd))
+		{
+			wxLogError("Corrupted compressed data");
+			_decompressor.reset();
+			break;
+		}
+		_inputOffset += inBefore - _inputSize;
+
+		if (inBefore == _inputSize && outBefore == outSize && (_inputEnd || _inputSize > 0))
+		{
+			// Nothing more to decompress
+			break;
+		}
+	}
+
+	data = _buffer.data();
+	size = _buffer.size() - outSize;
+	_offset += size;
+	return size > 0;
+}
+
+
+//
+// FramesFileReader
+//
+
+#ifdef HAVE_ZLIB
+// Size of a BGZF member (gzip member with its size in a "BC" extra subfield), 0 if not BGZF.
+static size_t GetBgzfMemberSize(const char* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	if (size < 18 || p[0] != 0x1F || p[1] != 0x8B || p[2] != 8 || (p[3] & 4) == 0)
+	{
+		return 0;
+	}
+	size_t end = 12 + (p[10] | (p[11] << 8));
+	if (end > size)
+	{
+		return 0;
+	}
+	for (size_t x = 12; x + 4 <= end; )
+	{
+		size_t length = p[x + 2] | (p[x + 3] << 8);
+		if (p[x] == 'B' && p[x + 1] == 'C' && length == 2 && x + 6 <= end)
+		{
+			size_t member = (p[x + 4] | (p[x + 5] << 8)) + 1;
+			return member <= size ? member : 0;
+		}
+		x += 4 + length;
+	}
+	return 0;
+}
+#endif // HAVE_ZLIB
+
+bool FramesFileReader::SplitFrames(COMPRESSION compression, const char* data, size_t size, std::vector<Frame>& frames)
+{
+	frames.clear();
+	for (size_t pos = 0; pos < size; )
+	{
+		size_t length = 0;
+		switch (compression)
+		{
+#ifdef HAVE_ZSTD
+		case COMPRESSION_ZSTD:
+			length = ::ZSTD_findFrameCompressedSize(data + pos, size - pos);
+			if (::ZSTD_isError(length))
+			{
+				return false;
+			}
+			break;
+#endif // HAVE_ZSTD
+#ifdef HAVE_ZLIB
+		case COMPRESSION_GZIP:
+			length = GetBgzfMemberSize(data + pos, size - pos);
+			if (length == 0)
+			{
+				return false;
+			}
+			break;
+#endif // HAVE_ZLIB
+		default:
+			return false;
+		}
+		frames.push_back({ pos, length });
+		pos += length;
+	}
+	return true;
+}
+
+FramesFileReader::FramesFileReader(std::unique_ptr<FileReader> source, COMPRESSION compression, std::vector<Frame> frames):
+_source(std::move(source)),
+_compression(compression),
+_frames(std::move(frames)),
+_threads(std::max(1u, std::thread::hardware_concurrency()))
+{
+	Prepare(_next);
+	_prefetch = std::thread([this]() { Decompress(_next); });
+}
+
+FramesFileReader::~FramesFileReader()
+{
+	if (_prefetch.joinable())
+	{
+		_prefetch.join();
+	}
+}
+
+bool FramesFileReader::Read(const char*& data, size_t& size)
+{
+	while (_part >= _current.size())
+	{
+		// Current batch is delivered: take the prefetched one and prefetch the following.
+		if (!_prefetch.joinable())
+		{
+			return false;
+		}
+		_prefetch.join();
+		std::swap(_current, _next);
+		_part = 0;
+		if (_current.empty())
+		{
+			return false;
+		}
+		Prepare(_next);
+		if (!_next.empty())
+		{
+			_prefetch = std::thread([this]() { Decompress(_next); });
+		}
+	}
+
+	Part& part = _current[_part++];
+	if (!part.ok)
+	{
+		wxLogError("Corrupted compressed data");
+		if (_prefetch.joinable())
+		{
+			_prefetch.join();
+		}
+		_current.clear();
+		_next.clear();
+		return false;
+	}
+
+	data = part.data.data();
+	size = part.data.size();
+	_offset += size;
+	_inputOffset = _frames[part.last - 1].offset + _frames[part.last - 1].size;
+	return true;
+}
+
+void FramesFileReader::Prepare(Batch& batch)
+{
+	// One part of consecutive frames for each thread.
+	batch.clear();
+	while (batch.size() < _threads && _nextFrame < _frames.size())
+	{
+		Part part;
+		part.first = _nextFrame;
+		for (size_t bytes = 0; _nextFrame < _frames.size() && bytes < BATCH_SIZE; ++_nextFrame)
+		{
+			bytes += _frames[_nextFrame].size;
+		}
+		part.last = _nextFrame;
+		part.ok = true;
+		batch.push_back(std::move(part));
+	}
+}
+
+void FramesFileReader::Decompress(Batch& batch)
+{
+	std::vector<std::thread> workers;
+	for (size_t n = 1; n < batch.size(); ++n)
+	{
+		workers.emplace_back([this, &batch, n]() { Decompress(batch[n]); });
+	}
+	if (!batch.empty())
+	{
+		Decompress(batch.front());
+	}
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void FramesFileReader::Decompress(Part& part)
+{
+	std::unique_ptr<Decompressor> decompressor = Decompressor::Create(_compression);
+	if (!decompressor)
+	{
+		part.ok = false;
+		return;
+	}
+
+	// Frames of a part are consecutive, they are decompressed as one stream.
+	const char* in = _source->GetData() + _frames[part.first].offset;
+	size_t inSize = _frames[part.last - 1].offset + _frames[part.last - 1].size - _frames[part.first].offset;
+
+	size_t used = 0;
+	part.data.resize(std::max<size_t>(inSize * 4, 64 * 1024));
+	for (;;)
+	{
+		// The decoder may still hold output once all the input is consumed.
+		if (used == part.data.size() || part.data.size() - used < inSize)
+		{
+			part.data.resize(part.data.size() * 2);
+		}
+		char* out = part.data.data() + used;
+		size_t outSize = part.data.size() - used;
+		size_t inBefore = inSize, outBefore = outSize;
+		if (!decompressor->Process(in, inSize, out, outSize, true))
+		{
+			part.ok = false;
+			break;
+		}
+		used += outBefore - outSize;
+		if (inBefore == inSize && outBefore == outSize && outBefore > 0)
+		{
+			// No progress with room for output: end of frames
+			break;
+		}
+	}
+	part.data.resize(used);
+}
@@ -0,0 +1,245 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+* reader.hpp
+* Copyright (C) 2019 Emilien Kia <Emilien.Kia+dev@gmail.com>
+*
+* logviewer is free software: you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by the
+* Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* logviewer is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _READER_HPP_
+#define _READER_HPP_
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <wx/string.h>
+#include <wx/ffile.h>
+
+
+/**
+ * Raw byte source for the log parser.
+ * Content is delivered by blocks, lines may span two consecutive blocks.
+ */
+class FileReader
+{
+public:
+	virtual ~FileReader() = default;
+
+	/** Retrieve the next block of bytes, valid until the next call.
+	 * Return false at end of file. */
+	virtual bool Read(const char*& data, size_t& size) = 0;
+
+	/** Whole content when directly addressable (mapped file), nullptr otherwise. */
+	virtual const char* GetData()const { return nullptr; }
+	virtual size_t GetSize()const { return 0; }
+
+	/** Count of bytes already delivered. */
+	virtual uint64_t GetOffset()const = 0;
+	/** Count of bytes already read from the file, differs from GetOffset() for compressed files. */
+	virtual uint64_t GetInputOffset()const { return GetOffset(); }
+	virtual bool IsCompressed()const { return false; }
+
+	/** Go to an offset of a streamed file before reading it, return false if not supported. */
+	virtual bool Seek(uint64_t offset) { return false; }
+
+	/** Open a file, mapping it in memory when possible and falling back to buffered reads.
+	 * Compressed files are detected and transparently decompressed. */
+	static std::unique_ptr<FileReader> Open(const wxString& path);
+
+	enum COMPRESSION
+	{
+		COMPRESSION_NONE,
+		COMPRESSION_GZIP,
+		COMPRESSION_ZSTD,
+		COMPRESSION_XZ
+	};
+
+	/** Detect compression from magic bytes. */
+	static COMPRESSION DetectCompression(const char* data, size_t size);
+
+	/** Fingerprint of the first length bytes of a file, from its head and its tail. 0 if not readable. */
+	static uint64_t Fingerprint(const wxString& path, uint64_t length);
+
+protected:
+	static std::unique_ptr<FileReader> OpenCompressed(COMPRESSION compression, std::unique_ptr<FileReader> source);
+};
+
+
+/**
+ * Read-only memory mapping of a whole file.
+ * The content is delivered as one single block, pointing directly into the mapping.
+ */
+class MappedFileReader : public FileReader
+{
+public:
+	MappedFileReader() = default;
+	MappedFileReader(const MappedFileReader&) = delete;
+	MappedFileReader& operator=(const MappedFileReader&) = delete;
+	virtual ~MappedFileReader();
+
+	bool Open(const wxString& path);
+	void Close();
+
+	virtual bool Read(const char*& data, size_t& size) override;
+
+	virtual const char* GetData()const override { return _data; }
+	virtual size_t GetSize()const override { return _size; }
+
+	virtual uint64_t GetOffset()const override { return _delivered ? _size : 0; }
+
+protected:
+	const char* _data = nullptr;
+	size_t _size = 0;
+	bool _delivered = false;
+#ifdef __WINDOWS__
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#endif // __WINDOWS__
+};
+
+
+/**
+ * Classic buffered file reading, used when a file cannot be mapped.
+ */
+class BufferedFileReader : public FileReader
+{
+public:
+	BufferedFileReader(size_t blockSize = 4 * 1024 * 1024) : _buffer(blockSize) {}
+
+	bool Open(const wxString& path);
+
+	virtual bool Read(const char*& data, size_t& size) override;
+
+	virtual uint64_t GetOffset()const override { return _offset; }
+
+	virtual bool Seek(uint64_t offset) override;
+
+	/** Read the first block without consuming it, it is delivered again by next Read(). */
+	bool Peek(const char*& data, size_t& size);
+
+protected:
+	wxFFile _file;
+	std::vector<char> _buffer;
+	uint64_t _offset = 0;
+	size_t _peeked = 0;
+};
+
+
+/**
+ * Streaming decoder of a compression format.
+ */
+class Decompressor
+{
+public:
+	virtual ~Decompressor() = default;
+
+	/** Decompress as much input as possible into the output, advancing both.
+	 * finish tells no more input will come. Return false on corrupted data. */
+	virtual bool Process(const char*& in, size_t& inSize, char*& out, size_t& outSize, bool finish) = 0;
+
+	/** Decoder of the compression format, nullptr if not supported by this build.
+	 * threads is a hint of how many threads a decoder can use. */
+	static std::unique_ptr<Decompressor> Create(FileReader::COMPRESSION compression, unsigned threads = 1);
+
+protected:
+	bool _ok = true;
+};
+
+
+/**
+ * Streaming decompression of a compressed source.
+ */
+class DecompressFileReader : public FileReader
+{
+public:
+	DecompressFileReader(std::unique_ptr<FileReader> source, std::unique_ptr<Decompressor> decompressor, size_t blockSize = 4 * 1024 * 1024);
+
+	virtual bool Read(const char*& data, size_t& size) override;
+
+	virtual uint64_t GetOffset()const override { return _offset; }
+	virtual uint64_t GetInputOffset()const override { return _inputOffset; }
+	virtual bool IsCompressed()const override { return true; }
+
+protected:
+	std::unique_ptr<FileReader> _source;
+	std::unique_ptr<Decompressor> _decompressor;
+
+	const char* _input = nullptr;
+	size_t _inputSize = 0;
+	bool _inputEnd = false;
+
+	std::vector<char> _buffer;
+	uint64_t _offset = 0, _inputOffset = 0;
+};
+
+
+/**
+ * Parallel decompression of independent compressed frames of a mapped file
+ * (zstd frames, BGZF gzip members).
+ * Frames are decompressed by batches, the next batch being decompressed
+ * while the current one is delivered.
+ */
+class FramesFileReader : public FileReader
+{
+public:
+	struct Frame
+	{
+		size_t offset, size;
+	};
+
+	FramesFileReader(std::unique_ptr<FileReader> source, COMPRESSION compression, std::vector<Frame> frames);
+	virtual ~FramesFileReader();
+
+	virtual bool Read(const char*& data, size_t& size) override;
+
+	virtual uint64_t GetOffset()const override { return _offset; }
+	virtual uint64_t GetInputOffset()const override { return _inputOffset; }
+	virtual bool IsCompressed()const override { return true; }
+
+	/** Split a mapped file in frames, return false if frames cannot be found without decompressing. */
+	static bool SplitFrames(COMPRESSION compression, const char* data, size_t size, std::vector<Frame>& frames);
+
+protected:
+	// Decompressed content of a range of frames
+	struct Part
+	{
+		size_t first, last;
+		std::vector<char> data;
+		bool ok;
+	};
+	typedef std::vector<Part> Batch;
+
+	std::unique_ptr<FileReader> _source;
+	COMPRESSION _compression;
+	std::vector<Frame> _frames;
+	unsigned _threads;
+
+	size_t _nextFrame = 0;		// First frame of next batch
+	Batch _current, _next;
+	size_t _part = 0;			// Next part of current batch to deliver
+	std::thread _prefetch;
+
+	uint64_t _offset = 0, _inputOffset = 0;
+
+	/** Compressed size of a batch for each thread. */
+	static const size_t BATCH_SIZE = 4 * 1024 * 1024;
+
+	void Prepare(Batch& batch);
+	void Decompress(Batch& batch);
+	void Decompress(Part& part);
+};
+
+
+#endif /* _READER_HPP_ */